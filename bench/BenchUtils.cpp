@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+
+using namespace std;
+
+namespace bench {
+	Samples::Samples(std::string name) :
+		mName(std::move(name))
+	{
+	}
+
+	void
+	Samples::add(clock::duration elapsed)
+	{
+		mSamples.push_back(static_cast<double>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+		mSorted = false;
+	}
+
+	double
+	Samples::percentile(double pct) const
+	{
+		if (mSamples.empty()) {
+			return 0.0;
+		}
+		if (!mSorted) {
+			std::sort(mSamples.begin(), mSamples.end());
+			mSorted = true;
+		}
+		// nearest-rank percentile
+		auto rank = static_cast<size_t>(std::ceil(pct / 100.0 * mSamples.size()));
+		rank = std::min(std::max<size_t>(rank, 1), mSamples.size());
+		return mSamples[rank - 1];
+	}
+
+	double
+	Samples::mean() const
+	{
+		if (mSamples.empty()) {
+			return 0.0;
+		}
+		return std::accumulate(mSamples.begin(), mSamples.end(), 0.0) / mSamples.size();
+	}
+
+	void
+	Samples::reportHeader()
+	{
+		printf("%-28s %10s %10s %10s %10s %10s %10s\n",
+			"case", "samples", "mean(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+	}
+
+	void
+	Samples::report() const
+	{
+		printf("%-28s %10zu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+			mName.c_str(),
+			mSamples.size(),
+			mean() / 1000.0,
+			percentile(50) / 1000.0,
+			percentile(90) / 1000.0,
+			percentile(99) / 1000.0,
+			percentile(100) / 1000.0);
+	}
+
+	Options::Options(int argc, char **argv) :
+		mArgs(argv + 1, argv + argc)
+	{
+	}
+
+	long
+	Options::get(const std::string &name, long defaultValue) const
+	{
+		const string flag = "--" + name;
+		for (size_t i = 0; i + 1 < mArgs.size(); ++i) {
+			if (mArgs[i] == flag) {
+				return strtol(mArgs[i + 1].c_str(), nullptr, 10);
+			}
+		}
+		return defaultValue;
+	}
+
+	bool
+	Options::has(const std::string &name) const
+	{
+		return std::find(mArgs.begin(), mArgs.end(), "--" + name) != mArgs.end();
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef BENCHUTILS_H
+#define BENCHUTILS_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace bench {
+	using clock = std::chrono::steady_clock;
+
+	/** Samples collects individual timings (in nanoseconds) for a single
+	 * benchmark case and reports on their distribution.
+	 */
+	class Samples {
+	public:
+		explicit Samples(std::string name);
+
+		void add(clock::duration elapsed);
+
+		/** percentile returns the requested percentile (0-100) of the
+		 * collected samples, in nanoseconds.
+		 */
+		double percentile(double pct) const;
+
+		double mean() const;
+
+		/** report writes a single line summary to stdout. */
+		void report() const;
+
+		static void reportHeader();
+
+	private:
+		std::string					mName;
+		mutable std::vector<double>	mSamples;
+		mutable bool				mSorted = true;
+	};
+
+	/** Options is a minimal "--name value" command line parser. */
+	class Options {
+	public:
+		Options(int argc, char **argv);
+
+		long get(const std::string &name, long defaultValue) const;
+		bool has(const std::string &name) const;
+
+	private:
+		std::vector<std::string>	mArgs;
+	};
+}
+
+#endif //BENCHUTILS_H
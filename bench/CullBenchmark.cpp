@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Culling benchmark.
+ *
+ * Scatters spheres around a camera and times the single-sphere CullInfo
+ * tests against their batch equivalents, checking the results agree.
+ *
+ * usage: xpmp_cull_bench [--iterations N] [--seed N]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "CullInfo.h"
+#include "BenchUtils.h"
+
+using namespace std;
+using namespace bench;
+
+// a camera at the origin looking down -z, with a 60 degree vertical field of
+// view, a 16:9 aspect ratio and the far clip plane 50km out.
+static CullInfo
+makeCamera()
+{
+	const float nearClip = 1.0f;
+	const float farClip = 50000.0f;
+	const float f = 1.0f / tanf(30.0f * 3.14159265f / 180.0f);
+	const float aspect = 16.0f / 9.0f;
+
+	const float modelView[16] = {
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+	};
+	const float projection[16] = {
+		f / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, f, 0.0f, 0.0f,
+		0.0f, 0.0f, (farClip + nearClip) / (nearClip - farClip), -1.0f,
+		0.0f, 0.0f, 2.0f * farClip * nearClip / (nearClip - farClip), 0.0f,
+	};
+	return CullInfo(modelView, projection);
+}
+
+struct Spheres {
+	vector<float>	x;
+	vector<float>	y;
+	vector<float>	z;
+	vector<float>	r;
+};
+
+// spheres of 10-40m radius scattered evenly through a 40km cube around the
+// camera, so most are culled, as they would be with traffic all around.
+static Spheres
+makeSpheres(size_t count, unsigned seed)
+{
+	mt19937 rng(seed);
+	uniform_real_distribution<float> position(-20000.0f, 20000.0f);
+	uniform_real_distribution<float> radius(10.0f, 40.0f);
+	Spheres spheres;
+	for (size_t n = 0; n < count; ++n) {
+		spheres.x.push_back(position(rng));
+		spheres.y.push_back(position(rng));
+		spheres.z.push_back(position(rng));
+		spheres.r.push_back(radius(rng));
+	}
+	return spheres;
+}
+
+int
+main(int argc, char **argv)
+{
+	Options opts(argc, argv);
+	const auto iterations = static_cast<size_t>(opts.get("iterations", 200));
+	const auto seed = static_cast<unsigned>(opts.get("seed", 1));
+
+	const CullInfo camera = makeCamera();
+	bool ok = true;
+
+	Samples::reportHeader();
+	for (size_t count: {1000, 10000, 100000}) {
+		const Spheres s = makeSpheres(count, seed);
+		vector<uint32_t> visible((count + 31) / 32);
+		vector<float> distA(count), distB(count);
+		vector<float> screenXA(count), screenYA(count), screenXB(count), screenYB(count);
+		size_t visibleCount = 0;
+		size_t mismatches = 0;
+
+		Samples visibleSingle("visible single " + to_string(count));
+		Samples visibleBatch("visible batch " + to_string(count));
+		Samples distanceSingle("distance single " + to_string(count));
+		Samples distanceBatch("distance batch " + to_string(count));
+		Samples screenSingle("2d single " + to_string(count));
+		Samples screenBatch("2d batch " + to_string(count));
+		for (size_t i = 0; i < iterations; ++i) {
+			auto start = clock::now();
+			visibleCount = 0;
+			for (size_t n = 0; n < count; ++n) {
+				visibleCount += camera.SphereIsVisible(s.x[n], s.y[n], s.z[n], s.r[n]) ? 1 : 0;
+			}
+			visibleSingle.add(clock::now() - start);
+
+			start = clock::now();
+			camera.SpheresVisible(s.x.data(), s.y.data(), s.z.data(), s.r.data(), count, visible.data());
+			visibleBatch.add(clock::now() - start);
+
+			start = clock::now();
+			for (size_t n = 0; n < count; ++n) {
+				distA[n] = camera.SphereDistanceSqr(s.x[n], s.y[n], s.z[n]);
+			}
+			distanceSingle.add(clock::now() - start);
+
+			start = clock::now();
+			camera.SpheresDistanceSqr(s.x.data(), s.y.data(), s.z.data(), count, distB.data());
+			distanceBatch.add(clock::now() - start);
+
+			start = clock::now();
+			for (size_t n = 0; n < count; ++n) {
+				camera.ConvertTo2D(s.x[n], s.y[n], s.z[n], 1.0f, &screenXA[n], &screenYA[n]);
+			}
+			screenSingle.add(clock::now() - start);
+
+			start = clock::now();
+			camera.ConvertTo2D(s.x.data(), s.y.data(), s.z.data(), count, screenXB.data(), screenYB.data());
+			screenBatch.add(clock::now() - start);
+		}
+
+		for (size_t n = 0; n < count; ++n) {
+			const bool single = camera.SphereIsVisible(s.x[n], s.y[n], s.z[n], s.r[n]);
+			const bool batch = (visible[n / 32] >> (n % 32)) & 1u;
+			if (single != batch ||
+				fabsf(distA[n] - distB[n]) > 1e-6f * distA[n] ||
+				fabsf(screenXA[n] - screenXB[n]) > 1e-5f * fmaxf(1.0f, fabsf(screenXA[n])) ||
+				fabsf(screenYA[n] - screenYB[n]) > 1e-5f * fmaxf(1.0f, fabsf(screenYA[n]))) {
+				++mismatches;
+			}
+		}
+
+		visibleSingle.report();
+		visibleBatch.report();
+		distanceSingle.report();
+		distanceBatch.report();
+		screenSingle.report();
+		screenBatch.report();
+		printf("    %zu of %zu visible, %zu mismatches\n", visibleCount, count, mismatches);
+		ok = ok && (mismatches == 0);
+	}
+	return ok ? 0 : 1;
+}
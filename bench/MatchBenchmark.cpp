@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Model matching benchmark.
+ *
+ * Generates a synthetic CSL library, loads it, and times CSL_MatchPlane
+ * across each of the major matching paths.
+ *
+ * usage: xpmp_match_bench [--models N] [--packages N] [--iterations N] [--seed N]
+ */
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include <XPMPMultiplayer.h>
+
+#include "CSLLibrary.h"
+#include "BenchUtils.h"
+#include "SyntheticLibrary.h"
+
+using namespace std;
+using namespace bench;
+
+struct MatchCase {
+	const char *					name;
+	function<PlaneType()>			query;
+	bool							allowDefault;
+};
+
+int
+main(int argc, char **argv)
+{
+	Options opts(argc, argv);
+	const auto models = static_cast<size_t>(opts.get("models", 10000));
+	const auto packages = static_cast<size_t>(opts.get("packages", 100));
+	const auto iterations = static_cast<size_t>(opts.get("iterations", 2000));
+	const auto seed = static_cast<unsigned>(opts.get("seed", 1));
+
+	printf("generating %zu models in %zu packages...\n", models, packages);
+	SyntheticLibrary library(models, packages, seed);
+
+	XPMPConfiguration_t config;
+	XPMPGetConfiguration(&config);
+	auto loadStart = clock::now();
+	XPMPMultiplayerInit(&config, library.relatedPath().c_str(), library.doc8643Path().c_str());
+	XPMPLoadCSLPackages(library.cslPath().c_str());
+	XPMPSetDefaultPlaneICAO(library.defaultICAO().c_str());
+	auto loadTime = clock::now() - loadStart;
+	printf("loaded %d models in %.1fms\n\n",
+		XPMPGetNumberOfInstalledModels(),
+		std::chrono::duration<double, std::milli>(loadTime).count());
+
+	const vector<MatchCase> cases = {
+		{"exact", [&library]() { return library.exactQuery(); }, true},
+		{"group", [&library]() { return library.groupQuery(); }, true},
+		{"livery-only", [&library]() { return library.liveryQuery(); }, true},
+		{"equipment-fallback", [&library]() { return library.fallbackQuery(); }, true},
+		{"default-plane", [&library]() { return library.unknownQuery(); }, true},
+	};
+
+	Samples::reportHeader();
+	for (const auto &matchCase: cases) {
+		// generate the queries up front so we only time the match itself.
+		vector<PlaneType> queries;
+		queries.reserve(iterations);
+		for (size_t i = 0; i < iterations; ++i) {
+			queries.push_back(matchCase.query());
+		}
+
+		Samples samples(matchCase.name);
+		long qualitySum = 0;
+		size_t misses = 0;
+		for (const auto &query: queries) {
+			int quality = -1;
+			const auto start = clock::now();
+			CSL *csl = CSL_MatchPlane(query, &quality, matchCase.allowDefault);
+			samples.add(clock::now() - start);
+			if (csl == nullptr) {
+				++misses;
+			} else {
+				qualitySum += quality;
+			}
+		}
+		samples.report();
+		if (opts.has("verbose")) {
+			printf("    mean quality %.2f, %zu misses\n",
+				queries.size() > misses ? static_cast<double>(qualitySum) / (queries.size() - misses) : -1.0,
+				misses);
+		}
+	}
+
+	XPMPMultiplayerCleanup();
+	return 0;
+}
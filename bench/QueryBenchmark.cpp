@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Traffic query benchmark.
+ *
+ * Scatters planes over a square around the stubbed local origin, runs a
+ * frame so they're indexed, then times XPMPQueryPlanesInRadius and
+ * XPMPQueryNearestPlanes from random points among them.  With --verify,
+ * each result is checked against a search of every plane.
+ *
+ * usage: xpmp_query_bench [--planes N] [--spread KM] [--iterations N] [--seed N] [--verify]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <XPMPMultiplayer.h>
+#include <XPLMGraphics.h>
+
+#include "FrameContext.h"
+#include "Renderer.h"
+#include "BenchUtils.h"
+#include "SyntheticLibrary.h"
+
+using namespace std;
+using namespace bench;
+
+static const double cFtToMeters = 0.3048;
+static const float cNauticalMile = 1852.0f;
+
+struct QueryPoint {
+	double	lat;
+	double	lon;
+	double	elevation;
+};
+
+struct QueryCase {
+	const char *	name;
+	function<size_t(const QueryPoint &, vector<XPMPPlaneDistance_t> &)>	query;
+	// the nearest n, or all of them within radius.
+	size_t			nearest;
+	float			radius;
+};
+
+static void
+toLocal(double lat, double lon, double elevation, double out[3])
+{
+	XPLMWorldToLocal(lat, lon, elevation * cFtToMeters, &out[0], &out[1], &out[2]);
+}
+
+int
+main(int argc, char **argv)
+{
+	Options opts(argc, argv);
+	const auto planeCount = static_cast<size_t>(opts.get("planes", 10000));
+	const auto spreadKm = static_cast<double>(opts.get("spread", 400));
+	const auto iterations = static_cast<size_t>(opts.get("iterations", 2000));
+	const auto seed = static_cast<unsigned>(opts.get("seed", 1));
+	const bool verify = opts.has("verify");
+
+	SyntheticLibrary library(200, 10, seed);
+	XPMPConfiguration_t config;
+	XPMPGetConfiguration(&config);
+	XPMPMultiplayerInit(&config, library.relatedPath().c_str(), library.doc8643Path().c_str());
+	XPMPLoadCSLPackages(library.cslPath().c_str());
+	XPMPSetDefaultPlaneICAO(library.defaultICAO().c_str());
+
+	// spread the planes over a square spreadKm across, from the ground up
+	// to the flight levels.
+	mt19937 random(seed);
+	const double halfSpread = spreadKm * 1000.0 / 2.0 / 111195.0;
+	uniform_real_distribution<double> position(-halfSpread, halfSpread);
+	uniform_real_distribution<double> altitude(0.0, 40000.0);
+	vector<XPMPPlaneID> planes;
+	vector<double> lat, lon, elevation;
+	for (size_t i = 0; i < planeCount; ++i) {
+		const auto type = library.exactQuery();
+		planes.push_back(XPMPCreatePlane(type.mICAO.c_str(), type.mAirline.c_str(), type.mLivery.c_str()));
+		lat.push_back(position(random));
+		lon.push_back(position(random));
+		elevation.push_back(altitude(random));
+	}
+	XPMPPlaneBatch_t batch = {};
+	batch.size = sizeof(batch);
+	batch.count = planeCount;
+	batch.planes = planes.data();
+	batch.lat = lat.data();
+	batch.lon = lon.data();
+	batch.elevation = elevation.data();
+	XPMPUpdatePlaneBatch(&batch);
+	Render_PrepFrame(FrameContext::capture(1, 0));
+	printf("%zu planes over %.0fkm\n\n", planeCount, spreadKm);
+
+	const vector<QueryCase> cases = {
+		{"radius 10nm", [](const QueryPoint &p, vector<XPMPPlaneDistance_t> &out) {
+			return XPMPQueryPlanesInRadius(p.lat, p.lon, p.elevation, 10.0f * cNauticalMile,
+				out.data(), sizeof(XPMPPlaneDistance_t), out.size());
+		}, 0, 10.0f * cNauticalMile},
+		{"radius 50nm", [](const QueryPoint &p, vector<XPMPPlaneDistance_t> &out) {
+			return XPMPQueryPlanesInRadius(p.lat, p.lon, p.elevation, 50.0f * cNauticalMile,
+				out.data(), sizeof(XPMPPlaneDistance_t), out.size());
+		}, 0, 50.0f * cNauticalMile},
+		{"nearest 20", [](const QueryPoint &p, vector<XPMPPlaneDistance_t> &out) {
+			return XPMPQueryNearestPlanes(p.lat, p.lon, p.elevation, out.data(), sizeof(XPMPPlaneDistance_t), 20);
+		}, 20, 0.0f},
+		{"nearest 63", [](const QueryPoint &p, vector<XPMPPlaneDistance_t> &out) {
+			return XPMPQueryNearestPlanes(p.lat, p.lon, p.elevation, out.data(), sizeof(XPMPPlaneDistance_t), 63);
+		}, 63, 0.0f},
+	};
+
+	// for --verify - every plane's position, to search through.
+	vector<double> localX(planeCount), localY(planeCount), localZ(planeCount);
+	for (size_t i = 0; i < planeCount; ++i) {
+		double local[3];
+		toLocal(lat[i], lon[i], elevation[i], local);
+		localX[i] = local[0];
+		localY[i] = local[1];
+		localZ[i] = local[2];
+	}
+
+	Samples::reportHeader();
+	vector<XPMPPlaneDistance_t> results(planeCount);
+	for (const auto &queryCase: cases) {
+		vector<QueryPoint> points;
+		points.reserve(iterations);
+		for (size_t i = 0; i < iterations; ++i) {
+			points.push_back(QueryPoint{position(random), position(random), altitude(random)});
+		}
+
+		Samples samples(queryCase.name);
+		size_t foundSum = 0;
+		size_t mismatches = 0;
+		for (const auto &point: points) {
+			const auto start = clock::now();
+			const size_t found = queryCase.query(point, results);
+			samples.add(clock::now() - start);
+			foundSum += found;
+			if (!verify) {
+				continue;
+			}
+			double local[3];
+			toLocal(point.lat, point.lon, point.elevation, local);
+			vector<float> distances;
+			for (size_t i = 0; i < planeCount; ++i) {
+				const double dx = localX[i] - local[0];
+				const double dy = localY[i] - local[1];
+				const double dz = localZ[i] - local[2];
+				const auto distance = static_cast<float>(sqrt(dx * dx + dy * dy + dz * dz));
+				if (queryCase.nearest > 0 || distance <= queryCase.radius) {
+					distances.push_back(distance);
+				}
+			}
+			sort(distances.begin(), distances.end());
+			if (queryCase.nearest > 0) {
+				distances.resize(min(distances.size(), queryCase.nearest));
+			}
+			bool same = (found == distances.size());
+			for (size_t n = 0; same && n < found; ++n) {
+				same = fabs(results[n].distance - distances[n]) <= 0.01f * (1.0f + distances[n] * 1e-5f);
+			}
+			mismatches += same ? 0 : 1;
+		}
+		samples.report();
+		printf("    mean %.1f planes found", static_cast<double>(foundSum) / iterations);
+		if (verify) {
+			printf(", %zu mismatches", mismatches);
+		}
+		printf("\n");
+	}
+
+	XPMPMultiplayerCleanup();
+	return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "SyntheticLibrary.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace bench {
+	static const size_t		cGroupSize = 4;
+	static const char		cWTC[] = {'L', 'M', 'H'};
+	static const char		cEngineTypes[] = {'J', 'P', 'T'};
+
+	static string
+	Code(char prefix, size_t n, size_t digits)
+	{
+		string rv(1, prefix);
+		string num;
+		for (size_t i = 0; i < digits; ++i) {
+			num.insert(num.begin(), static_cast<char>('A' + (n % 26)));
+			n /= 26;
+		}
+		return rv + num;
+	}
+
+	static void
+	MakeDir(const string &path)
+	{
+		if (mkdir(path.c_str(), 0755) != 0) {
+			throw runtime_error("couldn't create " + path);
+		}
+	}
+
+	SyntheticLibrary::SyntheticLibrary(size_t modelCount, size_t packageCount, unsigned seed) :
+		mRandom(seed)
+	{
+		char rootTemplate[] = "/tmp/xpmp_bench_XXXXXX";
+		if (mkdtemp(rootTemplate) == nullptr) {
+			throw runtime_error("couldn't create temporary directory");
+		}
+		mRoot = rootTemplate;
+		mCSLPath = mRoot + "/CSL";
+		mRelatedPath = mRoot + "/related.txt";
+		mDoc8643Path = mRoot + "/Doc8643.txt";
+		MakeDir(mCSLPath);
+
+		// one type per ~20 models, and enough groups to make it interesting.
+		const size_t typeCount = std::max<size_t>(cGroupSize * 8, modelCount / 20);
+		for (size_t t = 0; t < typeCount; ++t) {
+			Type type;
+			type.icao = Code('T', t, 3);
+			type.wtc = cWTC[t % 3];
+			type.equip = string("L") + static_cast<char>('1' + (t / 3) % 4) + cEngineTypes[(t / 12) % 3];
+			type.group = t / cGroupSize;
+			type.modelled = (t % cGroupSize) != (cGroupSize - 1);
+			if (!type.modelled) {
+				mUnmodelledTypes.push_back(mTypes.size());
+			}
+			mTypes.push_back(type);
+		}
+		for (size_t t = 0; t < std::max<size_t>(16, typeCount / 10); ++t) {
+			Type type;
+			type.icao = Code('F', t, 3);
+			type.wtc = cWTC[t % 3];
+			type.equip = string("L") + static_cast<char>('1' + (t / 3) % 4) + cEngineTypes[(t / 12) % 3];
+			type.group = SIZE_MAX;
+			type.modelled = false;
+			mFallbackTypes.push_back(type);
+		}
+
+		writeTypes();
+		writePackages(modelCount, std::max<size_t>(1, packageCount));
+	}
+
+	static int
+	RemoveEntry(const char *path, const struct stat *, int, struct FTW *)
+	{
+		return remove(path);
+	}
+
+	SyntheticLibrary::~SyntheticLibrary()
+	{
+		nftw(mRoot.c_str(), &RemoveEntry, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	void
+	SyntheticLibrary::writeTypes()
+	{
+		ofstream doc(mDoc8643Path);
+		for (const auto *types: {&mTypes, &mFallbackTypes}) {
+			for (const auto &type: *types) {
+				doc << "SYNTH\tSynthetic " << type.icao << "\t" << type.icao << "\t" << type.equip << "\t" << type.wtc << "\n";
+			}
+		}
+
+		ofstream related(mRelatedPath);
+		related << "; synthetic related.txt\n";
+		for (size_t t = 0; t < mTypes.size(); t += cGroupSize) {
+			for (size_t i = t; i < std::min(t + cGroupSize, mTypes.size()); ++i) {
+				related << mTypes[i].icao << (i + 1 < t + cGroupSize ? " " : "");
+			}
+			related << "\n";
+		}
+	}
+
+	void
+	SyntheticLibrary::writePackages(size_t modelCount, size_t packageCount)
+	{
+		std::vector<size_t> modelledTypes;
+		for (size_t t = 0; t < mTypes.size(); ++t) {
+			if (mTypes[t].modelled) {
+				modelledTypes.push_back(t);
+			}
+		}
+
+		size_t model = 0;
+		for (size_t p = 0; p < packageCount; ++p) {
+			char packageName[32];
+			snprintf(packageName, sizeof(packageName), "pkg%04zu", p);
+			const string packagePath = mCSLPath + "/" + packageName;
+			MakeDir(packagePath);
+
+			ofstream xsb(packagePath + "/xsb_aircraft.txt");
+			xsb << "EXPORT_NAME " << packageName << "\n\n";
+
+			const size_t lastModel = modelCount * (p + 1) / packageCount;
+			for (; model < lastModel; ++model) {
+				const size_t typeIdx = pick(modelledTypes);
+				const Type &type = mTypes[typeIdx];
+				const string airline = Code('A', std::uniform_int_distribution<size_t>(0, 299)(mRandom), 2);
+				const string livery = Code('L', std::uniform_int_distribution<size_t>(0, 9)(mRandom), 1);
+
+				char modelName[32];
+				snprintf(modelName, sizeof(modelName), "m%06zu", model);
+				xsb << "OBJ8_AIRCRAFT " << modelName << "\n";
+				xsb << "OBJ8 SOLID YES " << packageName << "/" << modelName << ".obj\n";
+
+				const int kind = std::uniform_int_distribution<int>(0, 9)(mRandom);
+				if (kind < 6) {
+					xsb << "LIVERY " << type.icao << " " << airline << " " << livery << "\n";
+					mLiveries.emplace_back(type.icao, airline, livery);
+					mLiveryTypes.push_back(typeIdx);
+				} else if (kind < 9) {
+					xsb << "AIRLINE " << type.icao << " " << airline << "\n";
+				} else {
+					xsb << "ICAO " << type.icao << "\n";
+				}
+				xsb << "\n";
+			}
+		}
+	}
+
+	PlaneType
+	SyntheticLibrary::exactQuery()
+	{
+		return pick(mLiveries);
+	}
+
+	PlaneType
+	SyntheticLibrary::groupQuery()
+	{
+		// take a real livery, and move it to the unmodelled type in its group.
+		const size_t idx = pickIndex(mLiveries.size());
+		const PlaneType &real = mLiveries[idx];
+		size_t unmodelled = mTypes[mLiveryTypes[idx]].group * cGroupSize + cGroupSize - 1;
+		if (unmodelled >= mTypes.size()) {
+			unmodelled = pick(mUnmodelledTypes);
+		}
+		return PlaneType(mTypes[unmodelled].icao, real.mAirline, real.mLivery);
+	}
+
+	PlaneType
+	SyntheticLibrary::liveryQuery()
+	{
+		const PlaneType &real = pick(mLiveries);
+		return PlaneType(real.mICAO, "", real.mLivery);
+	}
+
+	PlaneType
+	SyntheticLibrary::fallbackQuery()
+	{
+		return PlaneType(pick(mFallbackTypes).icao, "", "");
+	}
+
+	PlaneType
+	SyntheticLibrary::unknownQuery()
+	{
+		return PlaneType(Code('Z', std::uniform_int_distribution<size_t>(0, 17575)(mRandom), 3), "", "");
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef SYNTHETICLIBRARY_H
+#define SYNTHETICLIBRARY_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PlaneType.h"
+
+namespace bench {
+	/** SyntheticLibrary generates a CSL library, related.txt and Doc8643
+	 * table on disk for benchmarking purposes, and removes it again when
+	 * destroyed.
+	 *
+	 * One in four of the grouped types has no models, so it can only be
+	 * matched through its group.  A separate set of ungrouped, unmodelled
+	 * types exists only in Doc8643 to exercise the equipment fallback.
+	 */
+	class SyntheticLibrary {
+	public:
+		SyntheticLibrary(size_t modelCount, size_t packageCount, unsigned seed);
+		~SyntheticLibrary();
+
+		SyntheticLibrary(const SyntheticLibrary &) = delete;
+		SyntheticLibrary &operator=(const SyntheticLibrary &) = delete;
+
+		const std::string &cslPath() const { return mCSLPath; }
+		const std::string &relatedPath() const { return mRelatedPath; }
+		const std::string &doc8643Path() const { return mDoc8643Path; }
+		const std::string &defaultICAO() const { return mTypes.front().icao; }
+
+		/** a type that exists exactly, with airline and livery */
+		PlaneType exactQuery();
+		/** an unmodelled type that shares its group with modelled types */
+		PlaneType groupQuery();
+		/** a modelled type and livery with no airline */
+		PlaneType liveryQuery();
+		/** a type only known to Doc8643 */
+		PlaneType fallbackQuery();
+		/** a type nobody has ever heard of */
+		PlaneType unknownQuery();
+
+	private:
+		struct Type {
+			std::string	icao;
+			std::string	equip;
+			char		wtc;
+			size_t		group;
+			bool		modelled;
+		};
+
+		std::mt19937					mRandom;
+		std::string						mRoot;
+		std::string						mCSLPath;
+		std::string						mRelatedPath;
+		std::string						mDoc8643Path;
+		std::vector<Type>				mTypes;
+		std::vector<Type>				mFallbackTypes;
+		std::vector<size_t>				mUnmodelledTypes;
+		std::vector<PlaneType>			mLiveries;
+		std::vector<size_t>				mLiveryTypes;	// index into mTypes for each of mLiveries
+
+		void writeTypes();
+		void writePackages(size_t modelCount, size_t packageCount);
+
+		size_t pickIndex(size_t count)
+		{
+			return std::uniform_int_distribution<size_t>(0, count - 1)(mRandom);
+		}
+
+		template<class T>
+		const T &pick(const std::vector<T> &from)
+		{
+			return from[pickIndex(from.size())];
+		}
+	};
+}
+
+#endif //SYNTHETICLIBRARY_H
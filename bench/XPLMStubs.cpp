@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Stub implementations of the XPLM API, sufficient to drive the library
+ * outside of X-Plane.
+ *
+ * Datarefs, probes, objects and instances are all fake handles.  The
+ * directory functions are real, as the CSL loader needs them to find
+ * packages on disk.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <XPLMDataAccess.h>
+#include <XPLMUtilities.h>
+#include <XPLMPlanes.h>
+#include <XPLMPlugin.h>
+#include <XPLMProcessing.h>
+#include <XPLMScenery.h>
+#include <XPLMInstance.h>
+#include <XPLMGraphics.h>
+#include <XPLMCamera.h>
+
+static int		sFakeHandle = 0;
+
+static void *
+FakeHandle()
+{
+	return &sFakeHandle;
+}
+
+XPLM_API void
+XPLMDebugString(const char *inString)
+{
+	if (getenv("XPMP_BENCH_VERBOSE") != nullptr) {
+		fputs(inString, stderr);
+	}
+}
+
+XPLM_API XPLMDataRef
+XPLMFindDataRef(const char * /* inDataRefName */)
+{
+	return FakeHandle();
+}
+
+XPLM_API int
+XPLMGetDatai(XPLMDataRef /* inDataRef */)
+{
+	return 0;
+}
+
+XPLM_API void
+XPLMSetDatai(XPLMDataRef /* inDataRef */, int /* inValue */)
+{
+}
+
+XPLM_API float
+XPLMGetDataf(XPLMDataRef /* inDataRef */)
+{
+	return 0.0f;
+}
+
+XPLM_API int
+XPLMGetDatavf(XPLMDataRef /* inDataRef */, float *outValues, int /* inOffset */, int inMax)
+{
+	if (outValues != nullptr) {
+		std::fill(outValues, outValues + inMax, 0.0f);
+	}
+	return inMax;
+}
+
+XPLM_API void
+XPLMSetDatavf(XPLMDataRef /* inDataRef */, float * /* inValues */, int /* inoffset */, int /* inCount */)
+{
+}
+
+XPLM_API void
+XPLMSetDatavi(XPLMDataRef /* inDataRef */, int * /* inValues */, int /* inoffset */, int /* inCount */)
+{
+}
+
+XPLM_API void
+XPLMSetDatab(XPLMDataRef /* inDataRef */, void * /* inValue */, int /* inOffset */, int /* inLength */)
+{
+}
+
+XPLM_API XPLMDataRef
+XPLMRegisterDataAccessor(
+	const char * /* inDataName */,
+	XPLMDataTypeID /* inDataType */,
+	int /* inIsWritable */,
+	XPLMGetDatai_f /* inReadInt */,
+	XPLMSetDatai_f /* inWriteInt */,
+	XPLMGetDataf_f /* inReadFloat */,
+	XPLMSetDataf_f /* inWriteFloat */,
+	XPLMGetDatad_f /* inReadDouble */,
+	XPLMSetDatad_f /* inWriteDouble */,
+	XPLMGetDatavi_f /* inReadIntArray */,
+	XPLMSetDatavi_f /* inWriteIntArray */,
+	XPLMGetDatavf_f /* inReadFloatArray */,
+	XPLMSetDatavf_f /* inWriteFloatArray */,
+	XPLMGetDatab_f /* inReadData */,
+	XPLMSetDatab_f /* inWriteData */,
+	void * /* inReadRefcon */,
+	void * /* inWriteRefcon */)
+{
+	return FakeHandle();
+}
+
+XPLM_API int
+XPLMShareData(
+	const char * /* inDataName */,
+	XPLMDataTypeID /* inDataType */,
+	XPLMDataChanged_f /* inNotificationFunc */,
+	void * /* inNotificationRefcon */)
+{
+	return 1;
+}
+
+XPLM_API XPLMPluginID
+XPLMGetMyID(void)
+{
+	return 1;
+}
+
+XPLM_API const char *
+XPLMGetDirectorySeparator(void)
+{
+	return "/";
+}
+
+XPLM_API void
+XPLMGetSystemPath(char *outSystemPath)
+{
+	strcpy(outSystemPath, "/");
+}
+
+XPLM_API int
+XPLMGetDirectoryContents(
+	const char *inDirectoryPath,
+	int inFirstReturn,
+	char *outFileNames,
+	int inFileNameBufSize,
+	char **outIndices,
+	int inIndexCount,
+	int *outTotalFiles,
+	int *outReturnedFiles)
+{
+	std::vector<std::string> names;
+	DIR *dir = opendir(inDirectoryPath);
+	if (dir != nullptr) {
+		struct dirent *ent;
+		while ((ent = readdir(dir)) != nullptr) {
+			if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0) {
+				names.emplace_back(ent->d_name);
+			}
+		}
+		closedir(dir);
+	}
+	std::sort(names.begin(), names.end());
+
+	int returned = 0;
+	int bufUsed = 0;
+	bool complete = true;
+	for (size_t i = inFirstReturn; i < names.size(); ++i) {
+		const int len = static_cast<int>(names[i].size()) + 1;
+		if (returned >= inIndexCount || bufUsed + len > inFileNameBufSize) {
+			complete = false;
+			break;
+		}
+		memcpy(outFileNames + bufUsed, names[i].c_str(), len);
+		if (outIndices != nullptr) {
+			outIndices[returned] = outFileNames + bufUsed;
+		}
+		bufUsed += len;
+		++returned;
+	}
+	if (outTotalFiles != nullptr) {
+		*outTotalFiles = static_cast<int>(names.size());
+	}
+	if (outReturnedFiles != nullptr) {
+		*outReturnedFiles = returned;
+	}
+	return complete ? 1 : 0;
+}
+
+XPLM_API int
+XPLMIsFeatureEnabled(const char * /* inFeature */)
+{
+	return 1;
+}
+
+XPLM_API int
+XPLMAcquirePlanes(char ** /* inAircraft */, XPLMPlanesAvailable_f /* inCallback */, void * /* inRefcon */)
+{
+	return 1;
+}
+
+XPLM_API void
+XPLMReleasePlanes(void)
+{
+}
+
+XPLM_API void
+XPLMCountAircraft(int *outTotalAircraft, int *outActiveAircraft, XPLMPluginID *outController)
+{
+	if (outTotalAircraft != nullptr) {
+		*outTotalAircraft = 20;
+	}
+	if (outActiveAircraft != nullptr) {
+		*outActiveAircraft = 1;
+	}
+	if (outController != nullptr) {
+		*outController = XPLM_NO_PLUGIN_ID;
+	}
+}
+
+XPLM_API void
+XPLMSetActiveAircraftCount(int /* inCount */)
+{
+}
+
+XPLM_API XPLMProbeRef
+XPLMCreateProbe(XPLMProbeType /* inProbeType */)
+{
+	return FakeHandle();
+}
+
+XPLM_API XPLMProbeResult
+XPLMProbeTerrainXYZ(XPLMProbeRef /* inProbe */, float inX, float /* inY */, float inZ, XPLMProbeInfo_t *outInfo)
+{
+	outInfo->locationX = inX;
+	outInfo->locationY = 0.0f;
+	outInfo->locationZ = inZ;
+	return xplm_ProbeHitTerrain;
+}
+
+XPLM_API void
+XPLMLoadObjectAsync(const char * /* inPath */, XPLMObjectLoaded_f inCallback, void *inRefcon)
+{
+	// objects "load" instantly.
+	inCallback(FakeHandle(), inRefcon);
+}
+
+XPLM_API void
+XPLMUnloadObject(XPLMObjectRef /* inObject */)
+{
+}
+
+XPLM_API XPLMInstanceRef
+XPLMCreateInstance(XPLMObjectRef /* obj */, const char ** /* datarefs */)
+{
+	return FakeHandle();
+}
+
+XPLM_API void
+XPLMDestroyInstance(XPLMInstanceRef /* instance */)
+{
+}
+
+XPLM_API void
+XPLMInstanceSetPosition(XPLMInstanceRef /* instance */, const XPLMDrawInfo_t * /* new_position */, const float * /* data */)
+{
+}
+
+XPLM_API void
+XPLMWorldToLocal(double inLatitude, double inLongitude, double inAltitude, double *outX, double *outY, double *outZ)
+{
+	// a spherical earth, with the tangent plane at 0,0 (where the stubbed
+	// lat_ref and lon_ref put the reference point).
+	const double radius = 6378145.0;
+	const double lat = inLatitude * 3.14159265358979323846 / 180.0;
+	const double lon = inLongitude * 3.14159265358979323846 / 180.0;
+	const double r = radius + inAltitude;
+	*outX = r * std::cos(lat) * std::sin(lon);
+	*outY = r * std::cos(lat) * std::cos(lon) - radius;
+	*outZ = -r * std::sin(lat);
+}
+
+XPLM_API void
+XPLMRegisterFlightLoopCallback(XPLMFlightLoop_f /* inFlightLoop */, float /* inInterval */, void * /* inRefcon */)
+{
+}
+
+XPLM_API void
+XPLMUnregisterFlightLoopCallback(XPLMFlightLoop_f /* inFlightLoop */, void * /* inRefcon */)
+{
+}
+
+static int		sCycleNumber = 0;
+
+XPLM_API int
+XPLMGetCycleNumber(void)
+{
+	return ++sCycleNumber;
+}
+
+XPLM_API void
+XPLMReadCameraPosition(XPLMCameraPosition_t *outCameraPosition)
+{
+	*outCameraPosition = {};
+	outCameraPosition->zoom = 1.0f;
+}
@@ -83,6 +83,18 @@ extern "C" {
  * `xpmp2` is **NOT** API compatible with the original `xplanemp`.  Please
  * study the source and this documentation carefully before including it into
  * an existing project.
+ *
+ * Like the XPLM, libxplanemp must be called from X-Plane's main (sim) thread,
+ * with the exception of XPMPCreatePlane, XPMPCreatePlaneWithModelName,
+ * XPMPDestroyPlane, XPMPUpdatePlanes, XPMPGetTimestamp and XPMPGetPlaneSnapshot,
+ * which may be called from any thread.
+ * When called from other threads, these are queued and take effect at the
+ * start of the next frame, in the order they were made by that thread.
+ * Frames only run whilst multiplayer is enabled, so updates made from other
+ * threads before XPMPMultiplayerEnable or after XPMPMultiplayerDisable are
+ * dropped, and XPMPMultiplayerDisable cancels any queued plane creations.
+ * XPMPMultiplayerInit must be called from the sim thread so it can be
+ * identified.
 */
 
 /** XPMPConfiguration_t contains all of the configurable paramaters for
@@ -91,13 +103,32 @@ extern "C" {
  * This is not size-keyed as libxplanemp /should/ be directly linked to it's
  * main consumer, and so there shouldn't be any way for this to be out of step
  * with it's actual use.
+ *
+ * New fields are only ever added to the end, but any that an initialiser
+ * leaves out are zeroed, which isn't always their default - start from
+ * XPMPGetConfiguration() and change what you need instead.
  */
 typedef struct XPMPConfiguration_s {
 	float					maxFullAircraftRenderingDistance;	/// Beyond what distance do we start using lights-only rendering?
 	bool 					enableSurfaceClamping;		/// do we clamp all aircraft to the surface?
 	struct {
-		bool modelMatching;								/// Enable Verbose Debugging about Model matching
+		bool modelMatching;								/// Enable Verbose Debugging about Model matching (see also XPMPGetMatchTrace)
 	} debug;
+	bool					preferResidentModels;		/// when matching, prefer models whose objects are already loaded
+	int						residentMatchTolerance;		/// how many quality levels worse than the best match a loaded model may be and still be preferred
+	int						rematchSwapsPerFrame;		/// how many planes may change model per frame when they're re-matched after packages are loaded.  0 disables re-matching.
+	float					interpolationDelay;			/// how far (in seconds) behind the newest timestamped positions planes are played back.  Should be longer than the interval between updates.
+	float					maxExtrapolation;			/// how long (in seconds) a plane keeps moving past its newest timestamped position before it's stopped.
+	int						offscreenUpdateInterval;	/// planes outside the camera's view have their models updated only once every this many frames.  1 updates them every frame.
+	float					nearTierDistance;			/// planes in view within this distance (in km) have their models fully updated every frame.
+	float					nearTierScreenSize;			/// planes in view that would be at least this tall (as a fraction of the screen height) are fully updated every frame too, however far away they are.  0 disables this.
+	float					farTierDistance;			/// planes in view beyond this distance (in km) are fully updated every farTierUpdateInterval frames, rather than every midTierUpdateInterval.
+	int						midTierUpdateInterval;		/// planes in view between the near and far tiers have their models fully updated only once every this many frames, and are just moved in between.
+	int						farTierUpdateInterval;		/// planes in view beyond farTierDistance have their models fully updated only once every this many frames, and are just moved in between.
+	int						frameBudget;				/// how long (in microseconds) the per-frame update may take before work that can wait is put off to later frames.  The near tier is always updated.  0, the default, disables the limit.
+	float					maxLightsOnlyDistance;		/// Beyond what distance (in km) do we stop drawing planes at all?  0 leaves it to the visibility.
+	int						maxRenderedAircraft;		/// roughly the most planes drawn at once - beyond that, the furthest are culled.  0 is unlimited.
+	float					targetFrameRate;			/// if set, the full detail and lights-only distances and the number of planes drawn are scaled back as needed to hold this frame rate (see XPMPGetLODStatus).  0 disables this.
 } XPMPConfiguration_t;
 
 
@@ -132,9 +163,13 @@ void XPMPGetConfiguration(XPMPConfiguration_t *outConfig);
  * is clockwise from north.  Pitch is the number of degrees, positive is nose up, and roll
  * is positive equals roll right.
  *
- * Note that there is no notion of aircraft velocity or acceleration; you will be queried for
- * your position every rendering frame.  Higher level APIs can use velocity and acceleration.
+ * Positions may be pushed every frame, or (if you only get them occasionally, like from
+ * the network) timestamped and pushed as they arrive.  Timestamped positions are buffered
+ * per-plane, and played back XPMPConfiguration_t::interpolationDelay behind time,
+ * interpolating between them.  If they stop arriving, the plane is dead-reckoned from the
+ * last two for up to XPMPConfiguration_t::maxExtrapolation.
  *
+ * This is size-keyed - set size to sizeof(XPMPPlanePosition_t).
  */
 typedef	struct {
 	size_t	size;
@@ -147,6 +182,7 @@ typedef	struct {
 	char 	label[32];
     float 	offsetScale;
     bool 	clampToGround;
+    double	timestamp;		/// when this position was valid, from XPMPGetTimestamp.  0 applies it immediately instead.
 } XPMPPlanePosition_t;
 
 
@@ -232,6 +268,9 @@ typedef	struct {
 /**
  * XPMPPlaneID is a unique ID for an aircraft created by a plug-in.
  *
+ * IDs are opaque handles, not pointers.  Once a plane is destroyed, its ID is
+ * never valid again - passing it back in is harmless, and is ignored (or
+ * reported as a failed match where a quality is returned).
  */
 typedef	void *		XPMPPlaneID;
 
@@ -246,6 +285,55 @@ typedef struct {
 	XPMPPlaneSurveillance_t *surveillance;
 } XPMPUpdate_t;
 
+/** XPMPPlaneBatch_t is used to feed updates for many aircraft at once in
+ * structure-of-arrays form (see XPMPUpdatePlaneBatch)
+ *
+ * Each pointer refers to the first element of an array of count elements,
+ * with element n of each array belonging to planes[n].  Apart from planes,
+ * any of the arrays may be null, in which case that part of the state isn't
+ * updated.
+ *
+ * This is size-keyed - set size to sizeof(XPMPPlaneBatch_t).
+ */
+typedef struct {
+	size_t						size;
+	size_t						count;
+	const XPMPPlaneID			*planes;		/// planes to update.  Null IDs are skipped.
+	const double				*lat;			/// latitude in degrees
+	const double				*lon;			/// longitude in degrees
+	const double				*elevation;		/// elevation in feet MSL
+	const float					*pitch;			/// pitch in degrees
+	const float					*roll;			/// roll in degrees
+	const float					*heading;		/// true heading in degrees
+	const XPMPPlaneSurfaces_t	*surfaces;		/// packed surface states.  each must have it's size set.
+	const double				*timestamp;		/// when each position was valid, from XPMPGetTimestamp.  0 (or a null array) applies it immediately.
+} XPMPPlaneBatch_t;
+
+/** XPMPPlaneSnapshot_t is the state of a single plane as of the end of a frame
+ * (see XPMPGetPlaneSnapshot)
+ */
+typedef struct {
+	XPMPPlaneID		plane;
+	double			lat;			/// latitude in degrees
+	double			lon;			/// longitude in degrees
+	double			elevation;		/// elevation in feet MSL
+	double			localX;			/// position in X-Plane's local coordinates, as rendered
+	double			localY;
+	double			localZ;
+	float			distance;		/// distance from the camera in meters
+	bool			culled;			/// true if the plane isn't being drawn
+	int				matchQuality;	/// the quality of the model match (see XPMPGetPlaneModelQuality)
+	char			modelName[64];	/// the name of the model in use, or empty if there's none.
+} XPMPPlaneSnapshot_t;
+
+/** XPMPPlaneDistance_t is a plane found by XPMPQueryPlanesInRadius or
+ * XPMPQueryNearestPlanes.
+ */
+typedef struct {
+	XPMPPlaneID		plane;
+	float			distance;		/// the straight line distance to the plane in meters
+} XPMPPlaneDistance_t;
+
 /************************************************************************************
 * Some additional functional by den_rain
 ************************************************************************************/
@@ -348,6 +436,26 @@ int XPMPGetNumberOfInstalledModels(void);
  */
 void XPMPGetModelInfo(int inIndex, const char **outModelName, const char **outIcao, const char **outAirline, const char **outLivery);
 
+/** XPMPFindModels searches the loaded models for those whose ICAO type and
+ * airline codes begin with the provided prefixes, and returns their indices
+ * for use with XPMPGetModelInfo.
+ *
+ * Indices are returned in ascending order.  If there are more matches than
+ * will fit in outIndices, only the first inMaxIndices are written, but the
+ * total count is still returned so the caller can resize their buffer and
+ * retry.
+ *
+ * @param inICAOPrefix prefix of the ICAO type to match.  NULL or the empty
+ *    string matches any type.
+ * @param inAirlinePrefix prefix of the airline to match.  NULL or the empty
+ *    string matches any airline.
+ * @param outIndices pointer to an array to be filled with model indices.  May
+ *    be NULL if inMaxIndices is 0.
+ * @param inMaxIndices the number of elements available in outIndices
+ * @return the total number of models that matched.
+ */
+int XPMPFindModels(const char *inICAOPrefix, const char *inAirlinePrefix, int *outIndices, int inMaxIndices);
+
 /** XPMPCreatePlane creates a new plane for a plug-in and returns its ID.
  * The new aircraft will have a model and livery assigned based on the
  * ICAO/Airline/Livery triplet.
@@ -358,10 +466,15 @@ void XPMPGetModelInfo(int inIndex, const char **outModelName, const char **outIc
  *
  * Undetermined Livery or Airline codes should be specified as the empty string.
  *
+ * This may be called from any thread.  If it's called from a thread other
+ * than the sim thread, the ID is returned immediately, but the plane won't
+ * exist (and other calls will ignore it) until the start of the next frame.
+ *
  * @param inICAOCode ICAO code for the new aircraft
  * @param inAirline Airline code for the new aircraft
  * @param inLivery Livery code for the new aircraft
- * @return an opaque ID for the plane
+ * @return an opaque ID for the plane, or NULL if no more planes can be
+ *     created.
  */
 XPMPPlaneID	XPMPCreatePlane(
 		const char *			inICAOCode,
@@ -383,10 +496,13 @@ XPMPPlaneID	XPMPCreatePlane(
  *			in the xsb_aircraft.txt file in every package.  Case insensitivity
  *			also makes the search even slower.
  *
+ * This may be called from any thread - see XPMPCreatePlane.
+ *
  * @param inICAOCode ICAO code for the new aircraft
  * @param inAirline Airline code for the new aircraft
  * @param inLivery Livery code for the new aircraft
- * @return an opaque ID for the plane
+ * @return an opaque ID for the plane, or NULL if no more planes can be
+ *     created.
  */
 XPMPPlaneID	XPMPCreatePlaneWithModelName(
 		const char *			inModelName,
@@ -395,6 +511,11 @@ XPMPPlaneID	XPMPCreatePlaneWithModelName(
 		const char *			inLivery);
 
 /** XPMPDestroyPlane deallocates a created aircraft.
+ *
+ * Stale or invalid IDs are ignored (and logged if called from the sim
+ * thread).
+ *
+ * This may be called from any thread.
  *
  * @param inID the plane to destroy
  */
@@ -413,7 +534,7 @@ void			XPMPDestroyPlane(XPMPPlaneID inID);
  * @param force_change if this is true, the model will be changed irrespective
  * 		of quality, otherwise changes that decrease the quality of the match
  * 		will be elided.
- * @return the match quality (see notes)
+ * @return the match quality (see notes), or -1 if inPlaneID isn't valid.
  */
 int 	XPMPChangePlaneModel(
 		XPMPPlaneID				inPlaneID,
@@ -436,9 +557,88 @@ void	XPMPSetDefaultPlaneICAO(
  */
 long			XPMPCountPlanes(void);
 
+/** XPMPGetPlaneSnapshot copies out the state of all of the planes as it was
+ * at the end of the most recent frame.
+ *
+ * This may be called from any thread, and never blocks the sim.  The
+ * snapshot is consistent - all of the planes are from the same frame.
+ *
+ * @param outPlanes a pointer to the first element of an array of
+ * 		XPMPPlaneSnapshot_t to fill.  May be null if inMaxPlanes is 0.
+ * @param inSnapshotSize the size of a single XPMPPlaneSnapshot_t structure
+ * @param inMaxPlanes the number of elements in outPlanes
+ * @param outTimestamp if not null, is set to the time the snapshot was taken
+ * 		(see XPMPGetTimestamp), or 0 if there hasn't been one yet.
+ * @return the number of planes in the snapshot.  If this is more than
+ * 		inMaxPlanes, only the first inMaxPlanes were copied.
+ */
+size_t		XPMPGetPlaneSnapshot(
+	XPMPPlaneSnapshot_t *		outPlanes,
+	size_t						inSnapshotSize,
+	size_t						inMaxPlanes,
+	double *					outTimestamp);
+
+/** XPMPQueryPlanesInRadius finds the planes within a given distance of a
+ * point, nearest first.
+ *
+ * The planes are found from a spatial index of their positions as of the
+ * most recent frame, so only the planes near the point are looked at, and
+ * planes created since then won't be found.
+ *
+ * This must be called from the sim thread - calls from other threads find
+ * nothing and return 0.
+ *
+ * @param inLat the latitude of the point, in degrees
+ * @param inLon the longitude of the point, in degrees
+ * @param inElevation the elevation of the point, in feet MSL
+ * @param inRadius the distance to search out to, in meters (a nautical mile
+ * 		is 1852 meters)
+ * @param outPlanes a pointer to the first element of an array of
+ * 		XPMPPlaneDistance_t to fill.  May be null if inMaxPlanes is 0.
+ * @param inResultSize the size of a single XPMPPlaneDistance_t structure
+ * @param inMaxPlanes the number of elements in outPlanes
+ * @return the number of planes within the radius.  If this is more than
+ * 		inMaxPlanes, only the nearest inMaxPlanes were copied.
+ */
+size_t		XPMPQueryPlanesInRadius(
+	double						inLat,
+	double						inLon,
+	double						inElevation,
+	float						inRadius,
+	XPMPPlaneDistance_t *		outPlanes,
+	size_t						inResultSize,
+	size_t						inMaxPlanes);
+
+/** XPMPQueryNearestPlanes finds the planes nearest to a point, nearest
+ * first.  Like XPMPQueryPlanesInRadius, it works from the planes' positions
+ * as of the most recent frame, and must also be called from the sim thread.
+ *
+ * @param inLat the latitude of the point, in degrees
+ * @param inLon the longitude of the point, in degrees
+ * @param inElevation the elevation of the point, in feet MSL
+ * @param outPlanes a pointer to the first element of an array of
+ * 		XPMPPlaneDistance_t to fill.
+ * @param inResultSize the size of a single XPMPPlaneDistance_t structure
+ * @param inMaxPlanes the number of planes to find
+ * @return the number of planes copied - inMaxPlanes, unless there are
+ * 		fewer planes than that.
+ */
+size_t		XPMPQueryNearestPlanes(
+	double						inLat,
+	double						inLon,
+	double						inElevation,
+	XPMPPlaneDistance_t *		outPlanes,
+	size_t						inResultSize,
+	size_t						inMaxPlanes);
+
 /** XPMPUpdatePlanes performs a bulk update on a number of aircraft positions or
  * states
  *
+ * This may be called from any thread.  If it's called from a thread other
+ * than the sim thread, the updates are copied, so the structures can be
+ * reused as soon as it returns.  Updates from other threads are dropped
+ * whilst multiplayer is disabled.
+ *
  * @param inUpdates a pointer to the first element of an array of XPMPUpdate_t
  * @param inUpdateSize the size of a single XPMPUpdate_t structure
  * @param inCount the total count of elements to process.
@@ -448,6 +648,35 @@ void		XPMPUpdatePlanes(
 	size_t						inUpdateSize,
 	size_t						inCount);
 
+/** XPMPUpdatePlaneBatch performs a bulk update on a number of aircraft
+ * positions and states, taking the updates as parallel arrays.
+ *
+ * This avoids the per-plane indirection of XPMPUpdatePlanes - the arrays
+ * are copied straight into libxplanemp's own plane state, so network code
+ * can decode directly into them.
+ *
+ * Labels, offset scale and ground clamping aren't part of the batch - set
+ * those with XPMPUpdatePlanes.
+ *
+ * Unlike XPMPUpdatePlanes, this must be called from the sim thread - calls
+ * from other threads are ignored.
+ *
+ * @param inBatch the batch of updates to apply
+ */
+void		XPMPUpdatePlaneBatch(
+	const XPMPPlaneBatch_t *	inBatch);
+
+/** XPMPGetTimestamp returns the current time on the clock used to timestamp
+ * plane positions.
+ *
+ * The clock is monotonic, and counts seconds from an arbitrary point.
+ *
+ * This may be called from any thread.
+ *
+ * @return the current time in seconds
+ */
+double		XPMPGetTimestamp(void);
+
 /** XPMPIsICAOValid searches the models loaded to see if
  *
  * This functions searches through our global vector of valid ICAO codes and returns true if there
@@ -487,6 +716,62 @@ int			XPMPModelMatchQuality(
 		const char *				inAirline,
 		const char *				inLivery);
 
+/************************************************************************************
+ * MODEL MATCHING DIAGNOSTICS
+ ************************************************************************************/
+
+/** Bits in XPMPMatchTrace_t::passesTried.
+ *
+ * Passes 0 through 7 are the primary matching passes (see
+ * XPMPChangePlaneModel for their meaning), 8 through 13 the equipment-code
+ * fallback passes, and the last bit is set if the default plane was tried.
+ * The passes are only those searched for the requested type - if the default
+ * plane was tried, the passes searched for it aren't recorded, but the
+ * package and model it matched are.
+ */
+enum {
+	xpmpMatchTrace_FirstPrimaryPass		= 0,
+	xpmpMatchTrace_FirstFallbackPass	= 8,
+	xpmpMatchTrace_DefaultPass			= 14
+};
+
+/** XPMPMatchTrace_t is a compact record of a single model-match attempt.
+ *
+ * The type codes are truncated to fit their fields.
+ */
+typedef struct {
+	unsigned int	sequence;		/// monotonically increasing id of this match attempt
+	char			icao[8];		/// requested ICAO type
+	char			airline[8];		/// requested airline
+	char			livery[16];		/// requested livery
+	unsigned int	passesTried;	/// bitmask of the passes that were searched
+	int				quality;		/// resulting match quality, or -1 if there was no match
+	int				package;		/// index of the package the match came from, or -1
+	int				model;			/// model index (see XPMPGetModelInfo) of the match, or -1
+	unsigned int	elapsedNs;		/// time taken to perform the match, in nanoseconds
+} XPMPMatchTrace_t;
+
+/** XPMPGetMatchTrace copies the most recent model-match trace records out of
+ * the library's trace buffer.
+ *
+ * Every model match records a trace entry, so the buffer can be queried at any
+ * time without having to enable the (expensive) verbose matching debug.
+ *
+ * This may be called from any thread.
+ *
+ * @param outEntries array to copy the records into, oldest first.
+ * @param inMaxEntries the number of records outEntries can hold.
+ * @return the number of records copied.
+ */
+size_t		XPMPGetMatchTrace(
+	XPMPMatchTrace_t *			outEntries,
+	size_t						inMaxEntries);
+
+/** XPMPDumpMatchTrace writes the contents of the model-match trace buffer to
+ * X-Plane's log.txt
+ */
+void		XPMPDumpMatchTrace(void);
+
 /************************************************************************************
  * PLANE RENDERING API
  ************************************************************************************/
@@ -497,6 +782,29 @@ int			XPMPModelMatchQuality(
  */
 void		XPMPDumpOneCycle(void);
 
+/** XPMPLODStatus_t is the state of the level of detail controller (see
+ * XPMPConfiguration_t::targetFrameRate).
+ *
+ * The scales are between 0 and 1, and are all 1 if the controller is off.
+ *
+ * This is size-keyed - set size to sizeof(XPMPLODStatus_t).
+ */
+typedef struct {
+	size_t	size;
+	float	framePeriod;	/// the sim's frame time in seconds, smoothed
+	float	prepTime;		/// the time our per-frame update takes in seconds, smoothed
+	float	detailScale;	/// the scale applied to maxFullAircraftRenderingDistance
+	float	rangeScale;		/// the scale applied to maxLightsOnlyDistance (or the visibility)
+	float	countScale;		/// the scale applied to maxRenderedAircraft (or the number of planes)
+} XPMPLODStatus_t;
+
+/** XPMPGetLODStatus gets the state of the level of detail controller as of
+ * the most recent frame.
+ *
+ * @param outStatus the status to fill in.  Set outStatus->size first.
+ */
+void		XPMPGetLODStatus(XPMPLODStatus_t *outStatus);
+
 /************************************************************************************
  * MAP RENDERING API
  ************************************************************************************/
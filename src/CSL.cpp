@@ -23,6 +23,7 @@
  */
 
 #include <string>
+#include <cmath>
 #include <cstring>
 #include <XPLMDataAccess.h>
 #include <XPLMScenery.h>
@@ -31,9 +32,20 @@
 #include "XPMPMultiplayerVars.h"
 #include "Renderer.h"
 #include "TCASOverride.h"
+#include "TerrainCache.h"
+#include "LODController.h"
 
 using namespace std;
 
+// instances are culled beyond this fraction of the visibility, and unculled
+// again within this one...
+static const float cCullVisibility = 1.1f;
+static const float cUncullVisibility = 1.0f;
+
+// ... and once they've been culled for this many seconds, they release their
+// sim objects.
+static const double cReleaseDelay = 10.0;
+
 CSL::CSL()
 {
 	mOffsetSource = VerticalOffsetSource::None;
@@ -148,30 +160,63 @@ CSL::isUsable() const {
 	return true;
 }
 
+bool
+CSL::isResident() const {
+	return false;
+}
+
 void
 CSL::drawPlane(CSLInstanceData * /*instanceData*/, bool /*is_blend*/, int /*data*/) const
 {
 }
 
 void
-CSL::updateInstance(const CullInfo &cullInfo,
-                    double &x,
-                    double &y,
-                    double &z,
-                    double roll,
-                    double heading,
-                    double pitch,
-                    bool clampToSurface,
-                    float offsetScale,
-                    xpmp_LightStatus lights,
-                    CSLInstanceData *&instanceData,
-                    XPLMPlaneDrawState_t *state)
+CSLInstanceData::updateDistance(const FrameContext &frame, double x, double y, double z)
+{
+	mDistanceSqr = frame.cullInfo.SphereDistanceSqr(
+		static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+
+	// we need to assess cull state so we can work out if we need to render labels or not
+	const bool wasCulled = mCulled;
+	mCulled = false;
+	// cull if the aircraft is not visible due to poor horizontal visibility,
+	// or is further away than we're drawing planes.
+	float range = frame.visibility;
+	const float renderDistance = gLODController.renderDistance();
+	if (renderDistance > 0.0f && (range <= 0.0f || renderDistance < range)) {
+		range = renderDistance;
+	}
+	if (range > 0.0f) {
+		const float limit = range * (wasCulled ? cUncullVisibility : cCullVisibility);
+		if (mDistanceSqr > limit*limit) {
+			mCulled = true;
+		}
+	}
+	if (mCulled && !wasCulled) {
+		mCulledSince = frame.timestamp;
+	}
+}
+
+bool
+CSLInstanceData::canRelease(const FrameContext &frame) const
+{
+	return mCulled && (mReleased || (frame.timestamp - mCulledSince) >= cReleaseDelay);
+}
+
+bool
+CSL::positionInstance(double &x,
+                      double &y,
+                      double &z,
+                      bool clampToSurface,
+                      float offsetScale,
+                      bool probeTerrain,
+                      CSLInstanceData *&instanceData)
 {
 	if (instanceData == nullptr) {
 		newInstanceData(instanceData);
 	}
 	if (instanceData == nullptr) {
-		return;
+		return false;
 	}
 
 	if (offsetScale >= 0.0) {
@@ -179,36 +224,89 @@ CSL::updateInstance(const CullInfo &cullInfo,
 	}
 
 	// clamp to the surface if enabled
+	instanceData->mClampPending = false;
 	if (gConfiguration.enableSurfaceClamping && clampToSurface) {
-		XPLMProbeInfo_t	probeResult = {
-			sizeof(XPLMProbeInfo_t),
-		};
-		XPLMProbeResult r = XPLMProbeTerrainXYZ(gTerrainProbe,
-			static_cast<float>(x), static_cast<float>(y), static_cast<float>(z), &probeResult);
-		if (r == xplm_ProbeHitTerrain) {
-			double minY = probeResult.locationY + getVertOffset();
-			if (y < minY) {
-				y = minY;
-				instanceData->mClamped = true;
-			} else {
+		// if we're well clear of the terrain we last found under us, we can't
+		// have gone below it since, and there's no need to look again.
+		const bool haveGround = (instanceData->mGroundGeneration == gTerrainCache.generation());
+		if (haveGround) {
+			const double moved = std::hypot(x - instanceData->mGroundX, z - instanceData->mGroundZ);
+			if (y - instanceData->mGroundY > TerrainCache::cClearance + moved * TerrainCache::cMaxSlope) {
 				instanceData->mClamped = false;
+				return true;
 			}
 		}
+		double groundY = 0.0;
+		const auto result = probeTerrain ? gTerrainCache.heightAt(x, y, z, groundY) : TerrainCache::Result::OverBudget;
+		if (result == TerrainCache::Result::Found) {
+			instanceData->mGroundX = x;
+			instanceData->mGroundY = groundY;
+			instanceData->mGroundZ = z;
+			instanceData->mGroundGeneration = gTerrainCache.generation();
+		} else if (result == TerrainCache::Result::OverBudget) {
+			// we'll look again next frame (or, if we weren't to look at all,
+			// on the next full update) - until then, the last terrain we
+			// found will have to do.
+			instanceData->mClampPending = probeTerrain;
+			if (!haveGround) {
+				return true;
+			}
+			groundY = instanceData->mGroundY;
+		} else {
+			return true;
+		}
+		double minY = groundY + getVertOffset();
+		if (y < minY) {
+			y = minY;
+			instanceData->mClamped = true;
+		} else {
+			instanceData->mClamped = false;
+		}
 	} else {
 	    instanceData->mClamped = false;
 	}
+	return true;
+}
 
-	instanceData->mDistanceSqr = cullInfo.SphereDistanceSqr(
-		static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+void
+CSL::prepareInstance(const FrameContext &frame,
+                     double x,
+                     double y,
+                     double z,
+                     double roll,
+                     double heading,
+                     double pitch,
+                     xpmp_LightStatus lights,
+                     const XPLMPlaneDrawState_t *state,
+                     CSLInstanceData *instanceData) const
+{
+	instanceData->prepareInstance(this, frame, x, y, z, pitch, roll, heading, lights, state);
+}
 
-	// we need to assess cull state so we can work out if we need to render labels or not
-	instanceData->mCulled = false;
-	// cull if the aircraft is not visible due to poor horizontal visibility
-	if (gVisDataRef) {
-		float horizVis = XPLMGetDataf(gVisDataRef);
-		if (instanceData->mDistanceSqr > horizVis*horizVis) {
-			instanceData->mCulled = true;
-		}
+void
+CSL::moveInstance(double x,
+                  double y,
+                  double z,
+                  double roll,
+                  double heading,
+                  double pitch,
+                  CSLInstanceData *instanceData) const
+{
+	instanceData->moveInstance(this, x, y, z, pitch, roll, heading);
+}
+
+void
+CSL::applyInstance(CSLInstanceData *instanceData) const
+{
+	instanceData->applyInstance(this);
+	instanceData->mReleased = false;
+}
+
+void
+CSL::releaseInstance(CSLInstanceData *instanceData) const
+{
+	if (!instanceData->mReleased) {
+		instanceData->releaseInstance(this);
+		instanceData->mReleased = true;
 	}
-	instanceData->updateInstance(this, x, y, z, pitch, roll, heading, lights, state);
 }
\ No newline at end of file
@@ -31,6 +31,7 @@
 #include <XPMPMultiplayer.h>
 
 #include "CullInfo.h"
+#include "FrameContext.h"
 
 // forward declare XPMPPlane - we can't access it's details, but we can record info.
 class XPMPPlane;
@@ -49,18 +50,69 @@ public:
     float mDistanceSqr;        // the distance squared
     bool mCulled = false;
     bool mClamped = false;
+    bool mClampPending = false;    // couldn't be clamped this frame - try again next
+
+    // the terrain last found under the instance, from TerrainCache generation
+    // mGroundGeneration.
+    double mGroundX = 0.0;
+    double mGroundY = 0.0;
+    double mGroundZ = 0.0;
+    uint32_t mGroundGeneration = 0;
 
     virtual ~CSLInstanceData() = default;
 
+    /** updateDistance refreshes mDistanceSqr and mCulled for an instance at
+     * the given local position without touching the instance itself.
+     *
+     * Instances are culled once they're a little beyond the visibility, and
+     * not unculled until they're back within it, so planes hovering around
+     * the limit don't flicker.
+     */
+    void updateDistance(const FrameContext &frame, double x, double y, double z);
+
+    /** canRelease reports if the instance has been culled for long enough
+     * that it should let go of its sim objects (or already has).
+     */
+    bool canRelease(const FrameContext &frame) const;
+
+    /** isReleased reports if the instance has let go of its sim objects.
+     * They're recreated by the next applyInstance.
+     */
+    bool isReleased() const
+    {
+        return mReleased;
+    }
+
+    /** needsUpdate reports if the instance must be updated even though the
+     * plane it belongs to hasn't changed - ie: because it's still waiting for
+     * parts to load, or because mDistanceSqr now calls for a different level
+     * of detail.
+     */
+    virtual bool needsUpdate() const
+    {
+        return false;
+    }
+
     friend class CSL;
 
 protected:
     CSLInstanceData() = default;
 
-    /** the CSL parent class uses this method to update the individual
-     * instances
+    /** the CSL parent class uses this method to destroy the instance's sim
+     * objects while it's culled.  The next applyInstance must recreate
+     * them, so needsUpdate should return true until it has.  This is only
+     * called on the sim thread.
+     *
+     * @param csl the CSL record performing the release
+     */
+    virtual void releaseInstance(const CSL *csl) = 0;
+
+    /** the CSL parent class uses this method to work out the update for the
+     * individual instances.  This must not call the XPLM, as it may be
+     * called from a worker thread.
      *
      * @param csl the CSL record performing the update
+     * @param frame the values read from the sim for this frame
      * @param x X coordinate of the instance (in world units)
      * @param y Y coordinate of the instance (in world units)
      * @param z Z coordinate of the instance (in world units)
@@ -70,8 +122,9 @@ protected:
      * @param lights xpmp_LightStatus containing the light states for this instance
      * @param state XPLMPlaneDrawState_t containing the aircraft state for this instance
      */
-    virtual void updateInstance(
-        CSL *csl,
+    virtual void prepareInstance(
+        const CSL *csl,
+        const FrameContext &frame,
         double x,
         double y,
         double z,
@@ -79,7 +132,40 @@ protected:
         double roll,
         double heading,
         xpmp_LightStatus lights,
-        XPLMPlaneDrawState_t *state) = 0;
+        const XPLMPlaneDrawState_t *state) = 0;
+
+    /** the CSL parent class uses this method to move the instance without
+     * working out the rest of the update again.  Like prepareInstance, this
+     * must not call the XPLM.
+     *
+     * @param csl the CSL record performing the update
+     * @param x X coordinate of the instance (in world units)
+     * @param y Y coordinate of the instance (in world units)
+     * @param z Z coordinate of the instance (in world units)
+     * @param pitch
+     * @param roll
+     * @param heading
+     */
+    virtual void moveInstance(
+        const CSL *csl,
+        double x,
+        double y,
+        double z,
+        double pitch,
+        double roll,
+        double heading) = 0;
+
+    /** the CSL parent class uses this method to push the update worked out
+     * by prepareInstance (or moveInstance) into the sim.  This is only called on the sim
+     * thread.
+     *
+     * @param csl the CSL record performing the update
+     */
+    virtual void applyInstance(const CSL *csl) = 0;
+
+private:
+    double mCulledSince = 0.0;  // frame timestamp when mCulled was last set
+    bool mReleased = false;
 };
 
 /** a CSL represents a single multiplayer aircraft model with livery that can be
@@ -152,6 +238,13 @@ public:
      */
     virtual bool isUsable() const;
 
+    /** isResident() indicates if the resources required to render the CSL
+     * are already loaded.
+     *
+     * @return true if the CSL can be rendered without loading anything.
+     */
+    virtual bool isResident() const;
+
     void setICAO(const std::string &icaoCode);
 
     void setAirline(const std::string &icaoCode, const std::string &airline);
@@ -166,33 +259,94 @@ public:
 
     const std::string &getLivery() const;
 
-    /** updateInstance updates the instanceData for rendering this frame.  If
-     * the instanceData is not initialised, this method invokes the
-     * newInstanceData virtual method to produce it.
+    /** Updating an instance for a frame is done in three steps:
+     * positionInstance and applyInstance use the XPLM, and must be called on
+     * the sim thread, whilst prepareInstance does the rest of the work and
+     * may be called from a worker thread in between.
+     */
+
+    /** positionInstance places the instance in the world for this frame -
+     * applying the vertical offset, and clamping it to the surface if
+     * required.  If the instanceData is not initialised, this method invokes
+     * the newInstanceData virtual method to produce it.
      *
-     * @param cullInfo the CullInfo to use to cull objects
      * @param x
      * @param y
-     * @param z
-     * @param pitch
+     * @param z the local position of the plane - updated with the position
+     *     of the instance.
+     * @param clampToSurface
+     * @param offsetScale
+     * @param probeTerrain if false, clamp to the terrain last found under
+     *     the instance rather than looking it up again.
+     * @param instanceData the instanceData pointer in the XPMPPlane for this plane
+     * @return true if there's an instance to update.
+     */
+    virtual bool positionInstance(double &x,
+                                  double &y,
+                                  double &z,
+                                  bool clampToSurface,
+                                  float offsetScale,
+                                  bool probeTerrain,
+                                  CSLInstanceData *&instanceData);
+
+    /** prepareInstance works out everything the instance needs for this
+     * frame without touching the sim.  The instance's distance must already
+     * have been updated for the frame with CSLInstanceData::updateDistance.
+     *
+     * @param frame the values read from the sim for this frame
+     * @param x
+     * @param y
+     * @param z the position of the instance, from positionInstance
      * @param roll
      * @param heading
+     * @param pitch
      * @param lights
      * @param state
-     * @param instanceData the instanceData pointer in the XPMPPlane for this plane
+     * @param instanceData the instance to prepare.
+     */
+    virtual void prepareInstance(const FrameContext &frame,
+                                 double x,
+                                 double y,
+                                 double z,
+                                 double roll,
+                                 double heading,
+                                 double pitch,
+                                 xpmp_LightStatus lights,
+                                 const XPLMPlaneDrawState_t *state,
+                                 CSLInstanceData *instanceData) const;
+
+    /** moveInstance prepares an update that only moves the instance,
+     * leaving its level of detail and animation as they were last prepared.
+     * Like prepareInstance, this doesn't touch the sim.
+     *
+     * @param x
+     * @param y
+     * @param z the position of the instance, from positionInstance
+     * @param roll
+     * @param heading
+     * @param pitch
+     * @param instanceData the instance to move.
+     */
+    virtual void moveInstance(double x,
+                              double y,
+                              double z,
+                              double roll,
+                              double heading,
+                              double pitch,
+                              CSLInstanceData *instanceData) const;
+
+    /** applyInstance pushes the prepared update into the sim.
+     *
+     * @param instanceData the instance to apply.
+     */
+    virtual void applyInstance(CSLInstanceData *instanceData) const;
+
+    /** releaseInstance destroys the instance's sim objects while it's culled,
+     * to be recreated by the next applyInstance.
+     *
+     * @param instanceData the instance to release.
      */
-    virtual void updateInstance(const CullInfo &cullInfo,
-                                double &x,
-                                double &y,
-                                double &z,
-                                double roll,
-                                double heading,
-                                double pitch,
-                                bool clampToSurface,
-                                float offsetScale,
-                                xpmp_LightStatus lights,
-                                CSLInstanceData *&instanceData,
-                                XPLMPlaneDrawState_t *state);
+    virtual void releaseInstance(CSLInstanceData *instanceData) const;
 
     /* drawPlane is responsible for rendering the plane.
      */
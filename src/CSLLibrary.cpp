@@ -41,6 +41,8 @@
 #include "CSLLibrary.h"
 #include "XStringUtils.h"
 #include "XUtils.h"
+#include "MatchTrace.h"
+#include "RematchSweep.h"
 #include "obj8/Obj8CSL.h"
 
 using namespace std;
@@ -525,6 +527,8 @@ CSL_LoadData(const char *inRelated, const char *inDoc8643)
 {
 	bool ok = true;
 
+	RematchSweep::cancel();
+
 	// read the list of aircraft codes
 	FILE *aircraft_fi = fopen(inDoc8643, "r");
 
@@ -643,6 +647,8 @@ CSL_LoadCSL(const char *inFolderPath)
 	}
 
 	if (!packages.empty()) {
+		RematchSweep::cancel();
+
 		// iterator points to the first inserted package
 		auto iterator = gPackages.insert(gPackages.end(), packages.begin(), packages.end());
 
@@ -655,6 +661,7 @@ CSL_LoadCSL(const char *inFolderPath)
 			std::string packageContent = GetFileContent(packageFile);
 			ParseFullPackage(packageContent, package);
 		}
+		CSL_RebuildCatalog();
 	}
 
 #if 0
@@ -668,6 +675,89 @@ CSL_LoadCSL(const char *inFolderPath)
 	return ok;
 }
 
+/************************************************************************
+ * CSL CATALOG
+ ************************************************************************/
+
+void
+CSL_RebuildCatalog()
+{
+	gCatalog.models.clear();
+	gCatalog.byICAO.clear();
+	gCatalog.byAirline.clear();
+
+	for (auto &package: gPackages) {
+		package.catalogOffset = static_cast<int>(gCatalog.models.size());
+		gCatalog.models.insert(gCatalog.models.end(), package.planes.begin(), package.planes.end());
+	}
+
+	gCatalog.byICAO.reserve(gCatalog.models.size());
+	gCatalog.byAirline.reserve(gCatalog.models.size());
+	for (size_t i = 0; i < gCatalog.models.size(); ++i) {
+		const CSL *csl = gCatalog.models[i];
+		if (!csl->getICAO().empty()) {
+			gCatalog.byICAO.emplace_back(csl->getICAO(), static_cast<int>(i));
+		}
+		if (!csl->getAirline().empty()) {
+			gCatalog.byAirline.emplace_back(csl->getAirline(), static_cast<int>(i));
+		}
+	}
+	std::sort(gCatalog.byICAO.begin(), gCatalog.byICAO.end());
+	std::sort(gCatalog.byAirline.begin(), gCatalog.byAirline.end());
+	++gCatalog.generation;
+}
+
+static bool
+HasPrefix(const std::string &str, const std::string &prefix)
+{
+	return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+// returns the range of entries in a sorted catalog index whose keys start with
+// prefix
+static pair<vector<pair<string, int>>::const_iterator, vector<pair<string, int>>::const_iterator>
+PrefixRange(const vector<pair<string, int>> &index, const std::string &prefix)
+{
+	auto first = std::lower_bound(
+		index.begin(), index.end(), prefix, [](const pair<string, int> &entry, const string &key) {
+			return entry.first < key;
+		});
+	auto last = first;
+	while (last != index.end() && HasPrefix(last->first, prefix)) {
+		++last;
+	}
+	return make_pair(first, last);
+}
+
+void
+CSL_FindModels(const std::string &icaoPrefix, const std::string &airlinePrefix, std::vector<int> &outIndices)
+{
+	outIndices.clear();
+	if (icaoPrefix.empty() && airlinePrefix.empty()) {
+		outIndices.reserve(gCatalog.models.size());
+		for (size_t i = 0; i < gCatalog.models.size(); ++i) {
+			outIndices.push_back(static_cast<int>(i));
+		}
+		return;
+	}
+
+	// search whichever index we have a prefix for, then filter on the other.
+	if (!icaoPrefix.empty()) {
+		auto range = PrefixRange(gCatalog.byICAO, icaoPrefix);
+		for (auto iter = range.first; iter != range.second; ++iter) {
+			if (airlinePrefix.empty() || HasPrefix(gCatalog.models[iter->second]->getAirline(), airlinePrefix)) {
+				outIndices.push_back(iter->second);
+			}
+		}
+	} else {
+		auto range = PrefixRange(gCatalog.byAirline, airlinePrefix);
+		for (auto iter = range.first; iter != range.second; ++iter) {
+			outIndices.push_back(iter->second);
+		}
+	}
+	std::sort(outIndices.begin(), outIndices.end());
+}
+
 /************************************************************************
  * CSL MATCHING
  ************************************************************************/
@@ -684,11 +774,98 @@ static const int kUseICAO[] = {1, 1, 0, 0, 1, 1, 0, 0};
 static const int kUseAirline[] = {1, 1, 1, 1, 0, 0, 0, 0};
 static const int kUseLivery[] = {1, 0, 1, 0, 1, 0, 1, 0};
 
-CSL *
-CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
+// MatchSelector decides which of the candidate models found during the
+// matching passes we actually use.
+//
+// Candidates must be offered in order of decreasing quality.  Normally the
+// first candidate wins, but if preferResidentModels is set, we keep looking
+// for a model that is already loaded, so long as it's no more than
+// residentMatchTolerance levels worse than the first candidate.
+class MatchSelector {
+public:
+	explicit MatchSelector(bool verbose) :
+		mVerbose(verbose),
+		mPreferResident(gConfiguration.preferResidentModels),
+		mTolerance(std::max(0, gConfiguration.residentMatchTolerance))
+	{
+	}
+
+	/** offer a candidate to the selector.
+	 *
+	 * @return true if the search is complete, false if more candidates should
+	 *     be offered.
+	 */
+	bool offer(CSL *csl, int quality, int package, int model)
+	{
+		if (mCSL == nullptr) {
+			set(csl, quality, package, model);
+			return !mPreferResident || csl->isResident();
+		}
+		if (exhausted(quality)) {
+			return true;
+		}
+		if (csl->isResident()) {
+			if (mVerbose) {
+				XPLMDump() << XPMP_CLIENT_NAME " MATCH - Preferring resident model " << csl->getModelName() << "\n";
+			}
+			set(csl, quality, package, model);
+			return true;
+		}
+		return false;
+	}
+
+	/** exhausted returns true if no candidate of the given quality could
+	 * change the selection
+	 */
+	bool exhausted(int quality) const
+	{
+		return (mCSL != nullptr) && (!mPreferResident || quality > mFirstQuality + mTolerance);
+	}
+
+	CSL *finish(int *match_quality, MatchTrace::Builder &trace) const
+	{
+		if (mCSL != nullptr) {
+			if (match_quality != nullptr) {
+				*match_quality = mQuality;
+			}
+			trace.result(mQuality, mPackage, mModel);
+		}
+		return mCSL;
+	}
+
+	bool found() const
+	{
+		return mCSL != nullptr;
+	}
+
+private:
+	void set(CSL *csl, int quality, int package, int model)
+	{
+		if (mCSL == nullptr) {
+			mFirstQuality = quality;
+		}
+		mCSL = csl;
+		mQuality = quality;
+		mPackage = package;
+		mModel = model;
+	}
+
+	bool	mVerbose;
+	bool	mPreferResident;
+	int		mTolerance;
+	CSL *	mCSL = nullptr;
+	int		mFirstQuality = -1;
+	int		mQuality = -1;
+	int		mPackage = -1;
+	int		mModel = -1;
+};
+
+static CSL *
+MatchPlane(const PlaneType &type, int *match_quality, bool allow_default, bool verbose, MatchTrace::Builder &trace)
 {
 	string group;
 	string key;
+	MatchSelector selector(verbose);
 
 	auto group_iter = gGroupings.find(type.mICAO);
 	if (group_iter != gGroupings.end()) {
@@ -697,7 +874,7 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 
 	char buf[4096];
 
-	if (gConfiguration.debug.modelMatching) {
+	if (verbose) {
 		snprintf(
 			buf,
 			sizeof(buf),
@@ -708,11 +885,11 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 	}
 
 	// Now we go through our passes.
-	for (int n = 0; n < match_count; ++n) {
+	for (int n = 0; n < match_count && !selector.exhausted(n); ++n) {
 		// Build up the right key for this pass.
 		key = kUseICAO[n]?type.mICAO:group;
 		if (!kUseICAO[n] && group.empty()) {
-			if (gConfiguration.debug.modelMatching) {
+			if (verbose) {
 				snprintf(buf, sizeof(buf), XPMP_CLIENT_NAME " MATCH -    Skipping %d Due nil Group\n", n);
 				XPLMDebugString(buf);
 			}
@@ -720,7 +897,7 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 
 		if (kUseAirline[n]) {
 			if (type.mAirline.empty()) {
-				if (gConfiguration.debug.modelMatching) {
+				if (verbose) {
 					snprintf(buf, sizeof(buf), XPMP_CLIENT_NAME " MATCH -    Skipping %d Due Absent Airline\n", n);
 					XPLMDebugString(buf);
 				}
@@ -732,7 +909,7 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 
 		if (kUseLivery[n]) {
 			if (type.mLivery.empty()) {
-				if (gConfiguration.debug.modelMatching) {
+				if (verbose) {
 					snprintf(buf, sizeof(buf), XPMP_CLIENT_NAME " MATCH -    Skipping %d Due Absent Livery\n", n);
 					XPLMDebugString(buf);
 				}
@@ -742,17 +919,20 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 			key += type.mLivery;
 		}
 
-		if (gConfiguration.debug.modelMatching) {
+		if (verbose) {
 			snprintf(buf, sizeof(buf), XPMP_CLIENT_NAME " MATCH -    Group %d key %s\n", n, key.c_str());
 			XPLMDebugString(buf);
 		}
 
+		trace.passTried(xpmpMatchTrace_FirstPrimaryPass + n);
+
 		// Now go through each group and see if we match.
-		for (const auto &package: gPackages) {
+		for (size_t packageIdx = 0; packageIdx < gPackages.size(); ++packageIdx) {
+			const auto &package = gPackages[packageIdx];
 			auto iter = package.matches[n].find(key);
 			if (iter != package.matches[n].end()) {
 				if (!package.planes[iter->second]->isUsable()) {
-					if (gConfiguration.debug.modelMatching) {
+					if (verbose) {
 						snprintf(
 							buf,
 							sizeof(buf),
@@ -765,10 +945,7 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 					}
 					continue;
 				}
-				if (nullptr != match_quality) {
-					*match_quality = n;
-				}
-				if (gConfiguration.debug.modelMatching) {
+				if (verbose) {
 					snprintf(
 						buf,
 						sizeof(buf),
@@ -779,12 +956,22 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 						package.planes[iter->second]->getModelName().c_str());
 					XPLMDebugString(buf);
 				}
-				return package.planes[iter->second];
+				if (selector.offer(
+					package.planes[iter->second],
+					n,
+					static_cast<int>(packageIdx),
+					package.catalogOffset + iter->second)) {
+					return selector.finish(match_quality, trace);
+				}
 			}
 		}
 	}
 
-	if (gConfiguration.debug.modelMatching) {
+	if (selector.exhausted(match_count)) {
+		return selector.finish(match_quality, trace);
+	}
+
+	if (verbose && !selector.found()) {
 		XPLMDebugString(XPMP_CLIENT_NAME " MATCH - No match.\n");
 	}
 	if (match_quality) {
@@ -797,7 +984,7 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 
 	const auto model_it = gAircraftCodes.find(type.mICAO);
 	if (model_it != gAircraftCodes.end()) {
-		if (gConfiguration.debug.modelMatching) {
+		if (verbose) {
 			XPLMDebugString(XPMP_CLIENT_NAME " MATCH/eqp-fallback - Looking for a ");
 			switch (model_it->second.category) {
 			case 'L':
@@ -822,9 +1009,10 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 		// 3. match WTC, #egines ("2")
 		// 4. match WTC, enginetype ("P")
 		// 5. match WTC
-		for (int pass = 0; pass <= match_fallback_count; ++pass) {
+		for (int pass = 0; pass <= match_fallback_count && !selector.exhausted(match_count + pass); ++pass) {
+			trace.passTried(xpmpMatchTrace_FirstFallbackPass + pass);
 
-			if (gConfiguration.debug.modelMatching) {
+			if (verbose) {
 				switch (pass) {
 				case 1:
 					XPLMDebugString(XPMP_CLIENT_NAME " Match/eqp-fallback - matching WTC and configuration\n");
@@ -845,7 +1033,8 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 			}
 
 
-			for (const auto &package: gPackages) {
+			for (size_t packageIdx = 0; packageIdx < gPackages.size(); ++packageIdx) {
+				const auto &package = gPackages[packageIdx];
 				// now we traverse all generic aircraft types in the package
 				for (const auto &matchpair: package.matches[match_icao]) {
 					if (package.planes[matchpair.second]->isUsable()) {
@@ -879,15 +1068,18 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 								break;
 							}
 							// bingo
-							if (gConfiguration.debug.modelMatching) {
+							if (verbose) {
 								XPLMDebugString(XPMP_CLIENT_NAME " MATCH/eqp-fallback - found: ");
 								XPLMDebugString(matchpair.first.c_str());
 								XPLMDebugString("\n");
 							}
-							if (match_quality != nullptr) {
-								*match_quality = match_count + pass;
+							if (selector.offer(
+								package.planes[matchpair.second],
+								match_count + pass,
+								static_cast<int>(packageIdx),
+								package.catalogOffset + matchpair.second)) {
+								return selector.finish(match_quality, trace);
 							}
-							return package.planes[matchpair.second];
 						}
 					}
 				}
@@ -895,7 +1087,11 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 		}
 	}
 
-	if (gConfiguration.debug.modelMatching) {
+	if (selector.found()) {
+		return selector.finish(match_quality, trace);
+	}
+
+	if (verbose) {
 		XPLMDebugString(string("gAircraftCodes.find(" + type.mICAO + ") returned no match.\n").c_str());
 	}
 
@@ -906,17 +1102,34 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 		return nullptr;
 	}
 	int		defaultMatchQuality = 0;
-	auto *defCSL = CSL_MatchPlane(gDefaultPlane, &defaultMatchQuality, false);
+	trace.passTried(xpmpMatchTrace_DefaultPass);
+	// the default plane's passes go in a scratch entry, so the passes in
+	// ours are only those searched for the type we were asked for.
+	MatchTrace::Builder defaultTrace(gDefaultPlane);
+	auto *defCSL = MatchPlane(gDefaultPlane, &defaultMatchQuality, false, verbose, defaultTrace);
+	trace.adoptResult(defaultTrace);
+	if (defaultMatchQuality > 0) {
+		defaultMatchQuality += match_count + match_fallback_count;
+	} else {
+		defaultMatchQuality = -1;
+	}
+	trace.setQuality(defaultMatchQuality);
 	if (match_quality != nullptr) {
-		if (defaultMatchQuality > 0) {
-			*match_quality = defaultMatchQuality + match_count + match_fallback_count;
-		} else {
-			*match_quality = -1;
-		}
+		*match_quality = defaultMatchQuality;
 	}
 	return defCSL;
 }
 
+CSL *
+CSL_MatchPlane(const PlaneType &type, int *match_quality, bool allow_default, bool in_background)
+{
+	MatchTrace::Builder trace(type);
+	const bool verbose = gConfiguration.debug.modelMatching && !in_background;
+	auto *csl = MatchPlane(type, match_quality, allow_default, verbose, trace);
+	trace.commit();
+	return csl;
+}
+
 void
 CSL_Dump()
 {
@@ -84,8 +84,35 @@ bool			CSL_LoadCSL(const char *inFolderPath);
  *
  * if match_quality is set, it is set with the pass upon which a match was determined.  
  *   (see XPMPMultiplayerCSL.h)
+ *
+ * if in_background is set, no logging is done so it is safe to call from
+ * threads other than the sim thread.  The match data must not be modified
+ * whilst this is happening (see RematchSweep::cancel)
+ */
+CSL *			CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default, bool in_background = false);
+
+/** CSL_RebuildCatalog regenerates gCatalog from the currently loaded
+ * packages, and bumps the catalog generation so the live planes get
+ * re-matched.
+ *
+ * This must be called whenever gPackages is modified.
+ */
+void			CSL_RebuildCatalog();
+
+/** CSL_FindModels searches the catalog for models whose ICAO and airline
+ * codes start with the given prefixes.
+ *
+ * @param icaoPrefix prefix the model's ICAO code must start with.  Empty
+ *   matches every model.
+ * @param airlinePrefix prefix the model's airline code must start with.
+ *   Empty matches every model.
+ * @param outIndices vector to be populated with the catalog indices of the
+ *   matching models, in ascending order.
  */
-CSL *			CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default);
+void			CSL_FindModels(
+	const std::string &icaoPrefix,
+	const std::string &airlinePrefix,
+	std::vector<int> &outIndices);
 
 /*
  * CSL_Dump
@@ -23,10 +23,101 @@
  */
 
 #include "CullInfo.h"
+
+#include <algorithm>
+#include <cmath>
+
 #include <XPLMDataAccess.h>
 
 #include "XUtils.h"
 
+// The batch functions work on four floats at a time with whatever SIMD
+// instructions we can rely on for the target - SSE2 is part of x86-64, and
+// NEON of arm64.  Anything else gets the scalar versions.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLINFO_SIMD_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CULLINFO_SIMD_NEON
+#endif
+
+#if defined(CULLINFO_SIMD_SSE2)
+typedef __m128	vfloat;
+typedef __m128	vmask;
+
+static inline vfloat vLoad(const float *p)			{ return _mm_loadu_ps(p); }
+static inline void vStore(float *p, vfloat v)		{ _mm_storeu_ps(p, v); }
+static inline vfloat vSet(float f)					{ return _mm_set1_ps(f); }
+static inline vfloat vAdd(vfloat a, vfloat b)		{ return _mm_add_ps(a, b); }
+static inline vfloat vMul(vfloat a, vfloat b)		{ return _mm_mul_ps(a, b); }
+static inline vfloat vDiv(vfloat a, vfloat b)		{ return _mm_div_ps(a, b); }
+static inline vmask vLess(vfloat a, vfloat b)		{ return _mm_cmplt_ps(a, b); }
+static inline vmask vNotEqual(vfloat a, vfloat b)	{ return _mm_cmpneq_ps(a, b); }
+static inline vmask vOr(vmask a, vmask b)			{ return _mm_or_ps(a, b); }
+static inline vfloat vSelect(vmask m, vfloat a, vfloat b)
+{
+	return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+static inline unsigned vBits(vmask m)				{ return static_cast<unsigned>(_mm_movemask_ps(m)); }
+#define CULLINFO_SIMD
+#elif defined(CULLINFO_SIMD_NEON)
+typedef float32x4_t	vfloat;
+typedef uint32x4_t	vmask;
+
+static inline vfloat vLoad(const float *p)			{ return vld1q_f32(p); }
+static inline void vStore(float *p, vfloat v)		{ vst1q_f32(p, v); }
+static inline vfloat vSet(float f)					{ return vdupq_n_f32(f); }
+static inline vfloat vAdd(vfloat a, vfloat b)		{ return vaddq_f32(a, b); }
+static inline vfloat vMul(vfloat a, vfloat b)		{ return vmulq_f32(a, b); }
+static inline vfloat vDiv(vfloat a, vfloat b)		{ return vdivq_f32(a, b); }
+static inline vmask vLess(vfloat a, vfloat b)		{ return vcltq_f32(a, b); }
+static inline vmask vNotEqual(vfloat a, vfloat b)	{ return vmvnq_u32(vceqq_f32(a, b)); }
+static inline vmask vOr(vmask a, vmask b)			{ return vorrq_u32(a, b); }
+static inline vfloat vSelect(vmask m, vfloat a, vfloat b)	{ return vbslq_f32(m, a, b); }
+static inline unsigned vBits(vmask m)
+{
+	static const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(m, vld1q_u32(laneBits)));
+}
+#define CULLINFO_SIMD
+#endif
+
+#if defined(CULLINFO_SIMD)
+// the SIMD equivalent of multMatrixVec4f for a vector of (x, y, z, 1) - the
+// arithmetic is done in the same order, so the results are identical.
+static inline void
+multMatrixPoints(vfloat dst[4], const float m[16], vfloat x, vfloat y, vfloat z)
+{
+	for (int row = 0; row < 4; ++row) {
+		dst[row] = vAdd(vAdd(vAdd(vMul(x, vSet(m[row])), vMul(y, vSet(m[row + 4]))),
+			vMul(z, vSet(m[row + 8]))), vSet(m[row + 12]));
+	}
+}
+
+// ... and of normalizeMatrix.
+static inline void
+normalizePoints(vfloat vec[4])
+{
+	const vfloat one = vSet(1.0f);
+	const vmask hasW = vNotEqual(vec[3], vSet(0.0f));
+	const vfloat w = vDiv(one, vSelect(hasW, vec[3], one));
+	vec[0] = vSelect(hasW, vMul(vec[0], w), vec[0]);
+	vec[1] = vSelect(hasW, vMul(vec[1], w), vec[1]);
+	vec[2] = vSelect(hasW, vMul(vec[2], w), vec[2]);
+	vec[3] = vSelect(hasW, one, vec[3]);
+}
+
+// ... and of checkClip.
+static inline vmask
+clipPoints(const vfloat eye[4], const float clip[4], vfloat r)
+{
+	const vfloat d = vAdd(vAdd(vAdd(vAdd(vMul(eye[0], vSet(clip[0])), vMul(eye[1], vSet(clip[1]))),
+		vMul(eye[2], vSet(clip[2]))), vSet(clip[3])), r);
+	return vLess(d, vSet(0.0f));
+}
+#endif
+
 
 XPLMDataRef		CullInfo::projectionMatrixRef = nullptr;
 XPLMDataRef		CullInfo::modelviewMatrixRef = nullptr;
@@ -71,9 +162,26 @@ CullInfo::normalizeMatrix(float vec[4])
 CullInfo::CullInfo()
 {
 	// First, just read out the current OpenGL matrices...do this once at setup because it's not the fastest thing to do.
+	float	modelView[16] = {};
+	float	projection[16] = {};
 	if (modelviewMatrixRef && projectionMatrixRef) {
-		XPLMGetDatavf(modelviewMatrixRef, model_view, 0, 16);
-		XPLMGetDatavf(projectionMatrixRef, proj, 0, 16);
+		XPLMGetDatavf(modelviewMatrixRef, modelView, 0, 16);
+		XPLMGetDatavf(projectionMatrixRef, projection, 0, 16);
+	}
+	setMatrices(modelView, projection);
+}
+
+CullInfo::CullInfo(const float modelView[16], const float projection[16])
+{
+	setMatrices(modelView, projection);
+}
+
+void
+CullInfo::setMatrices(const float modelView[16], const float projection[16])
+{
+	for (int c = 0; c < 16; c++) {
+		model_view[c] = modelView[c];
+		proj[c] = projection[c];
 	}
 
 	// Now...what the heck is this?  Here's the deal: the clip planes have values in "clip" coordinates of: Left = (1,0,0,1)
@@ -151,6 +259,17 @@ CullInfo::SphereIsVisible(float x, float y, float z, float r) const
 	return true;
 }
 
+float
+CullInfo::ClipScale() const
+{
+	const float *planes[] = { nea_clip, far_clip, lft_clip, rgt_clip, bot_clip, top_clip };
+	float scale = 0.0f;
+	for (const float *clip: planes) {
+		scale = (std::max)(scale, std::sqrt(clip[0] * clip[0] + clip[1] * clip[1] + clip[2] * clip[2]));
+	}
+	return scale;
+}
+
 float
 CullInfo::SphereDistanceSqr(float x, float y, float z) const
 {
@@ -174,3 +293,75 @@ CullInfo::ConvertTo2D(float x, float y, float z, float w, float * out_x, float *
 	*out_x = screen[0];
 	*out_y = screen[1];
 }
+
+void
+CullInfo::SpheresVisible(const float *x, const float *y, const float *z, const float *r,
+	size_t count, uint32_t *outVisible) const
+{
+	for (size_t word = 0; word < (count + 31) / 32; ++word) {
+		outVisible[word] = 0;
+	}
+	size_t n = 0;
+#if defined(CULLINFO_SIMD)
+	// n is always a multiple of 4, so each block's bits fall in one word.
+	for (; n + 4 <= count; n += 4) {
+		vfloat eye[4];
+		multMatrixPoints(eye, model_view, vLoad(x + n), vLoad(y + n), vLoad(z + n));
+		normalizePoints(eye);
+		const vfloat radius = vLoad(r + n);
+		vmask culled = clipPoints(eye, nea_clip, radius);
+		culled = vOr(culled, clipPoints(eye, bot_clip, radius));
+		culled = vOr(culled, clipPoints(eye, top_clip, radius));
+		culled = vOr(culled, clipPoints(eye, lft_clip, radius));
+		culled = vOr(culled, clipPoints(eye, rgt_clip, radius));
+		culled = vOr(culled, clipPoints(eye, far_clip, radius));
+		outVisible[n / 32] |= (~vBits(culled) & 0xfu) << (n % 32);
+	}
+#endif
+	for (; n < count; ++n) {
+		if (SphereIsVisible(x[n], y[n], z[n], r[n])) {
+			outVisible[n / 32] |= 1u << (n % 32);
+		}
+	}
+}
+
+void
+CullInfo::SpheresDistanceSqr(const float *x, const float *y, const float *z,
+	size_t count, float *outDistanceSqr) const
+{
+	size_t n = 0;
+#if defined(CULLINFO_SIMD)
+	for (; n + 4 <= count; n += 4) {
+		vfloat eye[4];
+		multMatrixPoints(eye, model_view, vLoad(x + n), vLoad(y + n), vLoad(z + n));
+		vStore(outDistanceSqr + n, vAdd(vAdd(vMul(eye[0], eye[0]), vMul(eye[1], eye[1])), vMul(eye[2], eye[2])));
+	}
+#endif
+	for (; n < count; ++n) {
+		outDistanceSqr[n] = SphereDistanceSqr(x[n], y[n], z[n]);
+	}
+}
+
+void
+CullInfo::ConvertTo2D(const float *x, const float *y, const float *z,
+	size_t count, float *out_x, float *out_y) const
+{
+	size_t n = 0;
+#if defined(CULLINFO_SIMD)
+	for (; n + 4 <= count; n += 4) {
+		vfloat eye[4];
+		multMatrixPoints(eye, model_view, vLoad(x + n), vLoad(y + n), vLoad(z + n));
+		vfloat screen[4];
+		for (int row = 0; row < 4; ++row) {
+			screen[row] = vAdd(vAdd(vAdd(vMul(eye[0], vSet(proj[row])), vMul(eye[1], vSet(proj[row + 4]))),
+				vMul(eye[2], vSet(proj[row + 8]))), vMul(eye[3], vSet(proj[row + 12])));
+		}
+		normalizePoints(screen);
+		vStore(out_x + n, screen[0]);
+		vStore(out_y + n, screen[1]);
+	}
+#endif
+	for (; n < count; ++n) {
+		ConvertTo2D(x[n], y[n], z[n], 1.0f, out_x + n, out_y + n);
+	}
+}
@@ -25,6 +25,9 @@
 #ifndef CULLINFO_H
 #define CULLINFO_H
 
+#include <cstddef>
+#include <cstdint>
+
 #include <XPLMDataAccess.h>
 
 // This struct has everything we need to cull fast!
@@ -42,6 +45,11 @@ public:
      */
     CullInfo();
 
+    /** Creates a new CullInfo from the given (column-major, OpenGL style)
+     * modelview and projection matrices.
+     */
+    CullInfo(const float modelView[16], const float projection[16]);
+
     CullInfo(const CullInfo &src);
 
     /** SphereIsVisible performs a visibility check at the location (in view
@@ -67,6 +75,46 @@ public:
      */
     void ConvertTo2D(float x, float y, float z, float w, float *out_x, float *out_y) const;
 
+    /* The batch versions of the above take structure-of-arrays inputs, and
+     * give the same results as calling the single versions for each element
+     * in turn, bar any differences in rounding.  They use SSE2 or NEON where
+     * available, four spheres at a time.
+     */
+
+    /** SpheresVisible performs SphereIsVisible on count spheres.
+     *
+     * @param outVisible a bitmask of (count + 31) / 32 words.  Bit (n % 32)
+     *     of word (n / 32) is set if sphere n is visible, and clear if not.
+     */
+    void SpheresVisible(const float *x, const float *y, const float *z, const float *r,
+        size_t count, uint32_t *outVisible) const;
+
+    /** SpheresDistanceSqr performs SphereDistanceSqr on count positions. */
+    void SpheresDistanceSqr(const float *x, const float *y, const float *z,
+        size_t count, float *outDistanceSqr) const;
+
+    /** ConvertTo2D performs the single ConvertTo2D (with w = 1) on count
+     * positions.
+     */
+    void ConvertTo2D(const float *x, const float *y, const float *z,
+        size_t count, float *out_x, float *out_y) const;
+
+    /** ScreenScale returns the projection's vertical scale - something of
+     * radius r at distance d covers r * ScreenScale() / d of the height of
+     * the screen.
+     */
+    float ScreenScale() const
+    {
+        return proj[5];
+    }
+
+    /** ClipScale returns the most that a distance in world units can come to
+     * when measured against the clip planes, which aren't normalised - so
+     * anything within d of a point is within d * ClipScale() of it as far as
+     * SphereIsVisible's r is concerned.
+     */
+    float ClipScale() const;
+
 protected:
     float model_view[16];	// The model view matrix, to get from local OpenGL to eye coordinates.
     float proj[16];			// Proj matrix - this is just a hack to use for gluProject.
@@ -81,6 +129,8 @@ private:
 	static XPLMDataRef	projectionMatrixRef;
 	static XPLMDataRef	modelviewMatrixRef;
 
+	void setMatrices(const float modelView[16], const float projection[16]);
+
 	static void multMatrixVec4f(float dst[4], const float m[16], const float v[4]);
 	static void normalizeMatrix(float vec[4]);
 	static bool	checkClip(const float eye[4], const float clip[4], float r);
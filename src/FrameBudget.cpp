@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "FrameBudget.h"
+
+FrameBudget gFrameBudget;
+
+FrameBudget::FrameBudget() :
+	mStart(),
+	mDeadline(),
+	mLimited(false),
+	mExhausted(false),
+	mOverran(false),
+	mChecks(0),
+	mLastDuration(0.0f)
+{
+}
+
+void
+FrameBudget::begin(int microseconds)
+{
+	mLimited = (microseconds > 0);
+	mStart = clock::now();
+	mDeadline = mStart + std::chrono::microseconds(microseconds);
+	mExhausted = false;
+	mChecks = 0;
+}
+
+void
+FrameBudget::end()
+{
+	const auto now = clock::now();
+	mOverran = mLimited && (mExhausted || now > mDeadline);
+	mLastDuration = std::chrono::duration<float>(now - mStart).count();
+}
+
+bool
+FrameBudget::exhausted()
+{
+	if (mExhausted || !mLimited) {
+		return mExhausted;
+	}
+	if ((mChecks++ % cCheckInterval) == 0) {
+		mExhausted = (clock::now() > mDeadline);
+	}
+	return mExhausted;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef FRAMEBUDGET_H
+#define FRAMEBUDGET_H
+
+#include <chrono>
+
+/** FrameBudget keeps track of how long the per-frame update has taken, so
+ * work that can wait can be put off once it's run out of time.
+ *
+ * Reading the clock isn't free, so exhausted() only looks at it every
+ * cCheckInterval calls - it can run a little over.  Once the budget's
+ * exhausted, it stays that way until the next frame.
+ *
+ * Sim thread only.
+ */
+class FrameBudget {
+public:
+	FrameBudget();
+
+	/** begin starts timing a frame.
+	 *
+	 * @param microseconds how long the frame may take.  0 (or less) means
+	 *     there's no limit.
+	 */
+	void begin(int microseconds);
+
+	/** end stops timing the frame. */
+	void end();
+
+	/** @return true if the frame has run out of time. */
+	bool exhausted();
+
+	/** @return true if the last frame to end ran out of time. */
+	bool overran() const
+	{
+		return mOverran;
+	}
+
+	/** @return how long (in seconds) the last frame to end took. */
+	float lastDuration() const
+	{
+		return mLastDuration;
+	}
+
+private:
+	typedef std::chrono::steady_clock	clock;
+
+	static const unsigned cCheckInterval = 8;
+
+	clock::time_point	mStart;
+	clock::time_point	mDeadline;
+	bool				mLimited;
+	bool				mExhausted;
+	bool				mOverran;
+	unsigned			mChecks;
+	float				mLastDuration;
+};
+
+extern FrameBudget		gFrameBudget;		// The budget for the per-frame update.
+
+#endif //FRAMEBUDGET_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "FrameContext.h"
+
+#include <XPLMDataAccess.h>
+#include <XPLMUtilities.h>
+
+#include "XPMPMultiplayer.h"
+
+static XPLMDataRef	gVisDataRef = nullptr;
+static XPLMDataRef	gFlightTimeDataRef = nullptr;
+static XPLMDataRef	gFramePeriodDataRef = nullptr;
+static XPLMDataRef	gSunPitchDataRef = nullptr;
+static XPLMDataRef	gSceneryLoadingDataRef = nullptr;
+
+void
+FrameContext::init()
+{
+	gVisDataRef = XPLMFindDataRef("sim/graphics/view/visibility_effective_m");
+	if (gVisDataRef == nullptr) {
+		gVisDataRef = XPLMFindDataRef("sim/weather/visibility_effective_m");
+	}
+	if (gVisDataRef == nullptr) {
+		XPLMDebugString(
+			"WARNING: Default renderer could not find effective visibility in the sim.\n");
+	}
+	gFlightTimeDataRef = XPLMFindDataRef("sim/time/total_flight_time_sec");
+	gFramePeriodDataRef = XPLMFindDataRef("sim/operation/misc/frame_rate_period");
+	gSunPitchDataRef = XPLMFindDataRef("sim/graphics/scenery/sun_pitch_degrees");
+	gSceneryLoadingDataRef = XPLMFindDataRef("sim/graphics/scenery/async_scenery_load_in_progress");
+	CullInfo::init();
+}
+
+FrameContext
+FrameContext::capture(int cycle, uint32_t originGeneration)
+{
+	FrameContext frame = {
+		cycle,
+		XPMPGetTimestamp(),
+		gFlightTimeDataRef ? XPLMGetDataf(gFlightTimeDataRef) : 0.0f,
+		gFramePeriodDataRef ? XPLMGetDataf(gFramePeriodDataRef) : 0.0f,
+		gVisDataRef ? XPLMGetDataf(gVisDataRef) : 0.0f,
+		gSunPitchDataRef ? XPLMGetDataf(gSunPitchDataRef) : 0.0f,
+		gSceneryLoadingDataRef ? (XPLMGetDatai(gSceneryLoadingDataRef) != 0) : false,
+		{},
+		CullInfo(),
+		originGeneration,
+	};
+	XPLMReadCameraPosition(&frame.camera);
+	return frame;
+}
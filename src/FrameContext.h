@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef FRAMECONTEXT_H
+#define FRAMECONTEXT_H
+
+#include <cstdint>
+
+#include <XPLMCamera.h>
+
+#include "CullInfo.h"
+
+/** FrameContext holds everything the per-frame update needs to know about
+ * the sim, read once at the start of the frame by capture().
+ *
+ * The update is driven entirely from this rather than reading datarefs as it
+ * goes - so the values are consistent across the frame, worker threads can
+ * use them, and the update can be run against a recorded context.
+ */
+struct FrameContext {
+	int						cycle;				// XPLMGetCycleNumber()
+	double					timestamp;			// XPMPGetTimestamp()
+	float					flightTime;			// sim/time/total_flight_time_sec
+	float					framePeriod;		// how long the sim's last frame took, in seconds, or 0 if unknown
+	float					visibility;			// effective visibility in meters, or 0 if unknown
+	float					sunPitch;			// degrees above the horizon
+	bool					sceneryLoading;		// the sim is loading scenery in the background
+	XPLMCameraPosition_t	camera;
+	CullInfo				cullInfo;			// the camera's matrices and clip planes
+	uint32_t				originGeneration;	// the LocalTransform generation
+
+	/** init finds the datarefs capture() needs.  Must be called (once!)
+	 * before capture().
+	 */
+	static void init();
+
+	/** capture reads the context for the current frame from the sim.
+	 *
+	 * @param cycle the frame's XPLMGetCycleNumber()
+	 * @param originGeneration the LocalTransform generation for the frame
+	 */
+	static FrameContext capture(int cycle, uint32_t originGeneration);
+};
+
+#endif //FRAMECONTEXT_H
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "LODController.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
+
+LODController gLODController;
+
+// moveScale odr-uses this (std::max takes it by reference).
+constexpr float LODController::cMinScale;
+
+// the longest gap between frames we'll adjust the scales over - anything
+// longer is a pause, not a slow frame.
+static const float cMaxInterval = 0.25f;
+
+static float
+smooth(float smoothed, float sample)
+{
+	if (smoothed <= 0.0f) {
+		return sample;
+	}
+	return smoothed + LODController::cSmoothing * (sample - smoothed);
+}
+
+/** moveScale moves a scale by delta, if it can go that way at all.
+ *
+ * @return true if the scale was moved.
+ */
+static bool
+moveScale(float &scale, float delta)
+{
+	if ((delta < 0.0f && scale <= LODController::cMinScale) || (delta > 0.0f && scale >= 1.0f)) {
+		return false;
+	}
+	scale = std::min(std::max(scale + delta, LODController::cMinScale), 1.0f);
+	return true;
+}
+
+LODController::LODController() :
+	mLastTimestamp(0.0),
+	mFramePeriod(0.0f),
+	mPrepTime(0.0f),
+	mDetailScale(1.0f),
+	mRangeScale(1.0f),
+	mCountScale(1.0f),
+	mFullDetailDistance(0.0f),
+	mRenderDistance(0.0f)
+{
+}
+
+void
+LODController::update(const FrameContext &frame, float prepTime, const PlaneRegistry &planes)
+{
+	const double interval = frame.timestamp - mLastTimestamp;
+	const float dt = (mLastTimestamp > 0.0) ? static_cast<float>(std::min(std::max(interval, 0.0), double(cMaxInterval))) : 0.0f;
+	mLastTimestamp = frame.timestamp;
+
+	if (frame.framePeriod > 0.0f) {
+		mFramePeriod = smooth(mFramePeriod, frame.framePeriod);
+	}
+	mPrepTime = smooth(mPrepTime, std::max(prepTime, 0.0f));
+
+	if (gConfiguration.targetFrameRate > 0.0f && mFramePeriod > 0.0f) {
+		adjust(dt, 1.0f / gConfiguration.targetFrameRate);
+	} else {
+		mDetailScale = mRangeScale = mCountScale = 1.0f;
+	}
+
+	mFullDetailDistance = gConfiguration.maxFullAircraftRenderingDistance * 1000.0f * mDetailScale;
+
+	float range = (gConfiguration.maxLightsOnlyDistance > 0.0f) ? gConfiguration.maxLightsOnlyDistance * 1000.0f : frame.visibility;
+	range = std::max(range, 0.0f) * mRangeScale;
+
+	// we can only draw so many - so nothing further away than the furthest
+	// of those that we can.
+	const size_t planeCount = planes.size();
+	const size_t maxCount = (gConfiguration.maxRenderedAircraft > 0) ? static_cast<size_t>(gConfiguration.maxRenderedAircraft) : planeCount;
+	const auto maxRendered = static_cast<size_t>(std::lround(maxCount * mCountScale));
+	if (maxRendered < planeCount) {
+		mDistanceSqr.resize(planeCount);
+		for (size_t idx = 0; idx < planeCount; ++idx) {
+			mDistanceSqr[idx] = planes.distanceSqrAt(idx);
+		}
+		std::nth_element(mDistanceSqr.begin(), mDistanceSqr.begin() + maxRendered, mDistanceSqr.end());
+		const float countRange = std::sqrt(mDistanceSqr[maxRendered]);
+		if (range <= 0.0f || countRange < range) {
+			range = countRange;
+		}
+	}
+	mRenderDistance = range;
+}
+
+void
+LODController::adjust(float dt, float target)
+{
+	const float headroom = target / mFramePeriod - 1.0f;
+	if (headroom >= 0.0f && headroom <= cDeadband) {
+		return;
+	}
+	const float delta = std::min(std::max(headroom, -1.0f), 1.0f) * cMaxRate * dt;
+	if (delta < 0.0f) {
+		// if it's our update that's taking the time, drawing less won't help
+		// much - there have to be fewer planes.
+		if (mPrepTime > cMaxPrepShare * mFramePeriod && moveScale(mCountScale, delta)) {
+			return;
+		}
+		moveScale(mDetailScale, delta) || moveScale(mRangeScale, delta) || moveScale(mCountScale, delta);
+	} else {
+		moveScale(mCountScale, delta) || moveScale(mRangeScale, delta) || moveScale(mDetailScale, delta);
+	}
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef LODCONTROLLER_H
+#define LODCONTROLLER_H
+
+#include <vector>
+
+#include "FrameContext.h"
+
+class PlaneRegistry;
+
+/** LODController scales back how much we draw to hold
+ * XPMPConfiguration_t::targetFrameRate.
+ *
+ * It works from the sim's frame time and how long our own per-frame update
+ * takes, both smoothed, and adjusts three scales:
+ *
+ * - detailScale, applied to maxFullAircraftRenderingDistance
+ * - rangeScale, applied to maxLightsOnlyDistance (or, if that's not set,
+ *   the visibility)
+ * - countScale, applied to maxRenderedAircraft (or, if that's not set, the
+ *   number of planes)
+ *
+ * When the frame's running long, the detail goes first, then the range.  If
+ * our update is more than cMaxPrepShare of the frame, it's the number of
+ * planes that goes instead.  They come back in the reverse order once
+ * there's time to spare.  The scales never change by more than cMaxRate a
+ * second, and are only raised again once the frame time is more than
+ * cDeadband under the target, so they don't hunt.
+ *
+ * With no target frame rate, the scales are all 1.  The distances are worked
+ * out either way.
+ *
+ * Sim thread only, but the results may be read from the worker threads
+ * during the frame.
+ */
+class LODController {
+public:
+	// the least we'll scale anything back to.
+	static constexpr float cMinScale = 0.25f;
+
+	// how much of each new frame time goes into the smoothed one.
+	static constexpr float cSmoothing = 0.1f;
+
+	// how far (as a fraction of the target) the frame time must be under the
+	// target before the scales are raised.
+	static constexpr float cDeadband = 0.05f;
+
+	// the most a scale can change by in a second.
+	static constexpr float cMaxRate = 0.5f;
+
+	// the most of the frame our update should take.
+	static constexpr float cMaxPrepShare = 0.2f;
+
+	LODController();
+
+	/** update adjusts the scales for the frame, and works out the distances.
+	 *
+	 * @param frame the context for this frame
+	 * @param prepTime how long (in seconds) our last per-frame update took
+	 * @param planes the planes, with their distances as of
+	 *     PlaneRegistry::updateInView
+	 */
+	void update(const FrameContext &frame, float prepTime, const PlaneRegistry &planes);
+
+	float framePeriod() const
+	{
+		return mFramePeriod;
+	}
+
+	float prepTime() const
+	{
+		return mPrepTime;
+	}
+
+	float detailScale() const
+	{
+		return mDetailScale;
+	}
+
+	float rangeScale() const
+	{
+		return mRangeScale;
+	}
+
+	float countScale() const
+	{
+		return mCountScale;
+	}
+
+	/** @return the distance (in meters) beyond which planes are drawn lights
+	 *     only.
+	 */
+	float fullDetailDistance() const
+	{
+		return mFullDetailDistance;
+	}
+
+	/** @return the distance (in meters) beyond which planes aren't drawn at
+	 *     all, or 0 if there's no limit.
+	 */
+	float renderDistance() const
+	{
+		return mRenderDistance;
+	}
+
+private:
+	void adjust(float dt, float target);
+
+	double	mLastTimestamp;
+	float	mFramePeriod;
+	float	mPrepTime;
+	float	mDetailScale;
+	float	mRangeScale;
+	float	mCountScale;
+	float	mFullDetailDistance;
+	float	mRenderDistance;
+
+	// scratch for finding the distance to the furthest plane we can draw.
+	std::vector<float>	mDistanceSqr;
+};
+
+extern LODController	gLODController;		// The level of detail for this frame.
+
+#endif //LODCONTROLLER_H
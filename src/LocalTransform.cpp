@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "LocalTransform.h"
+
+#include <cmath>
+
+#include <XPLMDataAccess.h>
+#include <XPLMGraphics.h>
+
+#include "XPMPMultiplayerVars.h"
+#include "XUtils.h"
+
+static const double cDegToRad = 3.14159265358979323846 / 180.0;
+
+// sin and cos of small angles (|x| <= LocalTransform::cMaxAngle) as Taylor
+// series.  These are good to well below a millimeter at the earth's surface,
+// and unlike the library versions, are inlined and vectorise.
+static inline double
+smallSin(double x)
+{
+	const double x2 = x * x;
+	return x * (1.0 - x2 / 6.0 * (1.0 - x2 / 20.0 * (1.0 - x2 / 42.0 * (1.0 - x2 / 72.0 * (1.0 - x2 / 110.0)))));
+}
+
+static inline double
+smallCos(double x)
+{
+	const double x2 = x * x;
+	return 1.0 - x2 / 2.0 * (1.0 - x2 / 12.0 * (1.0 - x2 / 30.0 * (1.0 - x2 / 56.0 * (1.0 - x2 / 90.0 * (1.0 - x2 / 132.0)))));
+}
+
+// 1/sqrt(1 - x) for 0 <= x <= e^2 (which is less than 0.007), as a binomial
+// series - again, for the sake of vectorising.
+static inline double
+inverseSqrtOneMinus(double x)
+{
+	return 1.0 + x * (1.0 / 2.0 + x * (3.0 / 8.0 + x * (5.0 / 16.0 + x * (35.0 / 128.0 +
+		x * (63.0 / 256.0 + x * (231.0 / 1024.0 + x * (429.0 / 2048.0 + x * (6435.0 / 32768.0))))))));
+}
+
+LocalTransform::LocalTransform() :
+	mEarth{0.0, 0.0},
+	mRefLat(0.0),
+	mRefLon(0.0),
+	mSinRefLat(0.0),
+	mCosRefLat(1.0),
+	mRefX(0.0),
+	mRefZ(0.0),
+	mAnchorX(0.0),
+	mAnchorY(0.0),
+	mAnchorZ(0.0),
+	mGeneration(0),
+	mHaveRef(false),
+	mValid(false)
+{
+}
+
+bool
+LocalTransform::update()
+{
+	static XPLMDataRef latRefDataRef = XPLMFindDataRef("sim/flightmodel/position/lat_ref");
+	static XPLMDataRef lonRefDataRef = XPLMFindDataRef("sim/flightmodel/position/lon_ref");
+
+	if (latRefDataRef == nullptr || lonRefDataRef == nullptr) {
+		mValid = false;
+		return false;
+	}
+	const double latRef = XPLMGetDataf(latRefDataRef);
+	const double lonRef = XPLMGetDataf(lonRefDataRef);
+	if (mHaveRef && latRef == mRefLat && lonRef == mRefLon) {
+		return false;
+	}
+	mHaveRef = true;
+	++mGeneration;
+	mRefLat = latRef;
+	mRefLon = lonRef;
+
+	const bool wasValid = mValid;
+
+	// try WGS84 first...
+	anchor(model{6378137.0, 6.69437999014e-3});
+	mValid = validate();
+	if (!mValid) {
+		// ... then a sphere, with the radius taken from the sim's own idea of
+		// how far it is to a point half a degree north.
+		const double testAngle = 0.5;
+		double nx, ny, nz;
+		XPLMWorldToLocal(mRefLat + testAngle, mRefLon, 0.0, &nx, &ny, &nz);
+		const double chord = std::sqrt(
+			(nx - mAnchorX) * (nx - mAnchorX) + (ny - mAnchorY) * (ny - mAnchorY) + (nz - mAnchorZ) * (nz - mAnchorZ));
+		anchor(model{chord / (2.0 * std::sin(testAngle * cDegToRad / 2.0)), 0.0});
+		mValid = validate();
+	}
+	if (mValid != wasValid) {
+		if (mValid) {
+			XPLMDump() << XPMP_CLIENT_NAME " Using our own world to local transform, with "
+				<< ((mEarth.e2 > 0.0) ? "a WGS84" : "a spherical") << " earth\n";
+		} else {
+			XPLMDump() << XPMP_CLIENT_NAME " WARNING: our world to local transform doesn't match the sim's - "
+				"falling back to XPLMWorldToLocal\n";
+		}
+	}
+	return true;
+}
+
+void
+LocalTransform::anchor(const model &earth)
+{
+	mEarth = earth;
+	mSinRefLat = std::sin(mRefLat * cDegToRad);
+	mCosRefLat = std::cos(mRefLat * cDegToRad);
+	const double n0 = mEarth.a / std::sqrt(1.0 - mEarth.e2 * mSinRefLat * mSinRefLat);
+	mRefX = n0 * mCosRefLat;
+	mRefZ = n0 * (1.0 - mEarth.e2) * mSinRefLat;
+	XPLMWorldToLocal(mRefLat, mRefLon, 0.0, &mAnchorX, &mAnchorY, &mAnchorZ);
+}
+
+bool
+LocalTransform::validate() const
+{
+	// a spread of points either side of the reference point, at the surface
+	// and at cruise altitudes.
+	static const double offsets[][3] = {
+		{ 0.5, 0.0, 0.0 }, { -0.5, 0.0, 0.0 }, { 0.0, 0.5, 0.0 }, { 0.0, -0.5, 0.0 },
+		{ 0.3, 0.3, 35000.0 }, { -0.3, 0.3, 10000.0 }, { 0.3, -0.3, 1000.0 }, { 0.05, 0.05, 500.0 },
+	};
+	const size_t count = sizeof(offsets) / sizeof(offsets[0]);
+	double lat[count], lon[count], elevation[count];
+	double x[count], y[count], z[count];
+	uint8_t inRange[count];
+	for (size_t n = 0; n < count; ++n) {
+		lat[n] = mRefLat + offsets[n][0];
+		lon[n] = mRefLon + offsets[n][1];
+		elevation[n] = offsets[n][2];
+	}
+	transform(lat, lon, elevation, x, y, z, inRange, count);
+	for (size_t n = 0; n < count; ++n) {
+		double simX, simY, simZ;
+		XPLMWorldToLocal(lat[n], lon[n], elevation[n] * kFtToMeters, &simX, &simY, &simZ);
+		if (!inRange[n] ||
+			std::fabs(x[n] - simX) > cTolerance ||
+			std::fabs(y[n] - simY) > cTolerance ||
+			std::fabs(z[n] - simZ) > cTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+LocalTransform::transform(const double *lat, const double *lon, const double *elevationFt,
+	double *outX, double *outY, double *outZ, uint8_t *outInRange, size_t count) const
+{
+	// take copies so the compiler knows they can't change under us.
+	const double a = mEarth.a;
+	const double e2 = mEarth.e2;
+	const double refLat = mRefLat;
+	const double refLon = mRefLon;
+	const double sinRefLat = mSinRefLat;
+	const double cosRefLat = mCosRefLat;
+	const double refX = mRefX;
+	const double refZ = mRefZ;
+	const double anchorX = mAnchorX;
+	const double anchorY = mAnchorY;
+	const double anchorZ = mAnchorZ;
+
+	// this is deliberately branch-free.
+	for (size_t n = 0; n < count; ++n) {
+		const double dLat = (lat[n] - refLat) * cDegToRad;
+		double dLonDeg = lon[n] - refLon;
+		dLonDeg += (dLonDeg > 180.0) ? -360.0 : 0.0;
+		dLonDeg += (dLonDeg < -180.0) ? 360.0 : 0.0;
+		const double dLon = dLonDeg * cDegToRad;
+		const double h = elevationFt[n] * kFtToMeters;
+
+		const double sinDLat = smallSin(dLat);
+		const double cosDLat = smallCos(dLat);
+		const double sinLat = sinRefLat * cosDLat + cosRefLat * sinDLat;
+		const double cosLat = cosRefLat * cosDLat - sinRefLat * sinDLat;
+
+		// ECEF, rotated about the pole so the reference point has a
+		// longitude of 0.
+		const double primeVertical = a * inverseSqrtOneMinus(e2 * sinLat * sinLat);
+		const double dx = (primeVertical + h) * cosLat * smallCos(dLon) - refX;
+		const double dy = (primeVertical + h) * cosLat * smallSin(dLon);
+		const double dz = (primeVertical * (1.0 - e2) + h) * sinLat - refZ;
+
+		// and into east/north/up at the reference point.
+		const double east = dy;
+		const double north = cosRefLat * dz - sinRefLat * dx;
+		const double up = cosRefLat * dx + sinRefLat * dz;
+
+		outX[n] = anchorX + east;
+		outY[n] = anchorY + up;
+		outZ[n] = anchorZ - north;
+	}
+
+	// mixing the flags in with the doubles above stops it vectorising.
+	const double maxAngleDeg = cMaxAngle / cDegToRad;
+	for (size_t n = 0; n < count; ++n) {
+		const double dLat = std::fabs(lat[n] - refLat);
+		const double dLon = std::fabs(lon[n] - refLon);
+		outInRange[n] = static_cast<uint8_t>(
+			(dLat <= maxAngleDeg) & ((dLon <= maxAngleDeg) | (dLon >= 360.0 - maxAngleDeg)));
+	}
+}
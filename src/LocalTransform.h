@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef LOCALTRANSFORM_H
+#define LOCALTRANSFORM_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** LocalTransform converts world (lat/lon/elevation) positions into the
+ * sim's local OpenGL coordinates without calling XPLMWorldToLocal for each
+ * one.
+ *
+ * The local coordinate system is a tangent plane at the sim's reference
+ * point (sim/flightmodel/position/lat_ref and lon_ref) - x is east, y up and
+ * z south.  Whenever the reference point moves, we anchor ourselves to the
+ * sim by converting the reference point with XPLMWorldToLocal, and then check
+ * a handful of test points against it, trying a WGS84 earth and a sphere
+ * calibrated against the sim.  If neither agrees to within cTolerance, or we
+ * can't find the reference point, the transform is marked invalid and
+ * callers must use XPLMWorldToLocal instead.
+ *
+ * The conversion itself only needs the sines and cosines of the angles
+ * between each position and the reference point, which are evaluated as
+ * polynomials so the whole thing is straight-line arithmetic the compiler
+ * can vectorise.  Positions more than cMaxAngle away from the reference
+ * point are out of range of the polynomials, and are reported as such.
+ */
+class LocalTransform {
+public:
+	// the largest difference in latitude or longitude (in radians) from the
+	// reference point we'll transform.  About 1100km.
+	static constexpr double cMaxAngle = 0.175;
+
+	// the largest error (in meters) at the test points we'll accept.
+	static constexpr double cTolerance = 0.05;
+
+	LocalTransform();
+
+	/** update checks the sim's reference point, and if it's moved, re-anchors
+	 * and re-validates the transform.  Sim thread only.
+	 *
+	 * @return true if the reference point has moved since the last update.
+	 */
+	bool update();
+
+	/** isValid reports if transform can be used. */
+	bool isValid() const
+	{
+		return mValid;
+	}
+
+	/** generation is bumped every time the reference point moves, so
+	 * anything holding local coordinates can tell if they're out of date.
+	 */
+	uint32_t generation() const
+	{
+		return mGeneration;
+	}
+
+	/** transform converts count positions from the world to local
+	 * coordinates.  This doesn't call the XPLM.
+	 *
+	 * @param lat latitudes in degrees
+	 * @param lon longitudes in degrees
+	 * @param elevationFt elevations in feet MSL
+	 * @param outX
+	 * @param outY
+	 * @param outZ the local coordinates
+	 * @param outInRange set to 1 if the position was converted, 0 if it's
+	 *     too far from the reference point and XPLMWorldToLocal must be used
+	 * @param count the number of positions
+	 */
+	void transform(const double *lat, const double *lon, const double *elevationFt,
+		double *outX, double *outY, double *outZ, uint8_t *outInRange, size_t count) const;
+
+private:
+	// the earth model & reference point.
+	struct model {
+		double	a;				// semi-major axis (meters)
+		double	e2;				// eccentricity squared
+	};
+
+	void anchor(const model &earth);
+	bool validate() const;
+
+	model	mEarth;
+	double	mRefLat;		// degrees
+	double	mRefLon;		// degrees
+	double	mSinRefLat;
+	double	mCosRefLat;
+	double	mRefX;			// the reference point in the rotated ECEF frame
+	double	mRefZ;
+	double	mAnchorX;		// the reference point in local coordinates
+	double	mAnchorY;
+	double	mAnchorZ;
+	uint32_t	mGeneration;
+	bool	mHaveRef;
+	bool	mValid;
+};
+
+#endif //LOCALTRANSFORM_H
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/** BoundedQueue is a fixed-capacity, lock-free multi-producer
+ * multi-consumer queue (after Dmitry Vyukov's bounded MPMC queue).
+ *
+ * Each cell carries a sequence number which tells producers and consumers
+ * whether it's ready to be written or read, so the only contention is on the
+ * enqueue and dequeue positions.
+ *
+ * Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class BoundedQueue {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "BoundedQueue capacity must be a power of two");
+public:
+	BoundedQueue() :
+		mEnqueuePos(0),
+		mDequeuePos(0)
+	{
+		for (size_t i = 0; i < Capacity; ++i) {
+			mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	BoundedQueue(const BoundedQueue &) = delete;
+	BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+	/** @return false if the queue is full */
+	bool tryPush(const T &value)
+	{
+		cell *thisCell;
+		size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			thisCell = &mCells[pos & cMask];
+			const size_t seq = thisCell->sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0) {
+				if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		thisCell->data = value;
+		thisCell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** @return false if the queue is empty */
+	bool tryPop(T &outValue)
+	{
+		cell *thisCell;
+		size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			thisCell = &mCells[pos & cMask];
+			const size_t seq = thisCell->sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0) {
+				if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = mDequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+		outValue = thisCell->data;
+		thisCell->sequence.store(pos + cMask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static const size_t		cMask = Capacity - 1;
+
+	struct cell {
+		std::atomic<size_t>	sequence;
+		T					data;
+	};
+
+	cell							mCells[Capacity];
+	alignas(64) std::atomic<size_t>	mEnqueuePos;
+	alignas(64) std::atomic<size_t>	mDequeuePos;
+};
+
+/** MPSCQueue is an unbounded, lock-free multi-producer single-consumer
+ * queue (after Dmitry Vyukov's intrusive MPSC node queue).
+ *
+ * Pushing is wait-free - a single atomic exchange.  The consumer may
+ * briefly see the queue as empty whilst a push is half-way done; anything
+ * it misses will be picked up on the next pop.
+ *
+ * Only one thread may pop.
+ */
+template <typename T>
+class MPSCQueue {
+public:
+	MPSCQueue() :
+		mHead(new node()),
+		mTail(mHead.load(std::memory_order_relaxed))
+	{
+	}
+
+	~MPSCQueue()
+	{
+		T discard;
+		while (tryPop(discard)) {
+		}
+		delete mTail;
+	}
+
+	MPSCQueue(const MPSCQueue &) = delete;
+	MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+	void push(T value)
+	{
+		auto *newNode = new node(std::move(value));
+		node *prev = mHead.exchange(newNode, std::memory_order_acq_rel);
+		prev->next.store(newNode, std::memory_order_release);
+	}
+
+	/** @return false if the queue is empty */
+	bool tryPop(T &outValue)
+	{
+		node *tail = mTail;
+		node *next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr) {
+			return false;
+		}
+		outValue = std::move(next->value);
+		mTail = next;
+		delete tail;
+		return true;
+	}
+
+	/** consume pops everything that had been pushed when it was called,
+	 * passing each value to fn.  Anything pushed whilst it's running is left
+	 * for next time, so busy producers can't keep the consumer here forever.
+	 *
+	 * @return the number of values consumed
+	 */
+	template <typename F>
+	size_t consume(F &&fn)
+	{
+		node *last = mHead.load(std::memory_order_acquire);
+		size_t count = 0;
+		while (mTail != last) {
+			node *next = mTail->next.load(std::memory_order_acquire);
+			if (next == nullptr) {
+				break;
+			}
+			fn(std::move(next->value));
+			delete mTail;
+			mTail = next;
+			++count;
+		}
+		return count;
+	}
+
+private:
+	struct node {
+		node() :
+			next(nullptr)
+		{
+		}
+
+		explicit node(T &&newValue) :
+			next(nullptr),
+			value(std::move(newValue))
+		{
+		}
+
+		std::atomic<node *>	next;
+		T					value;
+	};
+
+	std::atomic<node *>		mHead;	// most recently pushed - producers only
+	node *					mTail;	// already consumed - consumer only
+};
+
+#endif //LOCKFREEQUEUE_H
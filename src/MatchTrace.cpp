@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "MatchTrace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "XPMPMultiplayerVars.h"
+#include "XUtils.h"
+
+using namespace std;
+
+MatchTrace::slot				MatchTrace::sRing[MatchTrace::cRingSize];
+std::atomic<uint64_t>			MatchTrace::sHead(0);
+const size_t					MatchTrace::cRingSize;
+
+static void
+CopyTruncated(char *dst, size_t dstSize, const std::string &src)
+{
+	const size_t len = std::min(src.size(), dstSize - 1);
+	memcpy(dst, src.data(), len);
+	dst[len] = '\0';
+}
+
+MatchTrace::Builder::Builder(const PlaneType &type) :
+	mEntry{},
+	mStart(std::chrono::steady_clock::now())
+{
+	CopyTruncated(mEntry.icao, sizeof(mEntry.icao), type.mICAO);
+	CopyTruncated(mEntry.airline, sizeof(mEntry.airline), type.mAirline);
+	CopyTruncated(mEntry.livery, sizeof(mEntry.livery), type.mLivery);
+	mEntry.quality = -1;
+	mEntry.package = -1;
+	mEntry.model = -1;
+}
+
+void
+MatchTrace::Builder::commit()
+{
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - mStart).count();
+	mEntry.elapsedNs = static_cast<unsigned int>(std::min<long long>(elapsed, 0xffffffffLL));
+	record(mEntry);
+}
+
+void
+MatchTrace::record(XPMPMatchTrace_t &entry)
+{
+	const uint64_t idx = sHead.fetch_add(1, std::memory_order_relaxed);
+	slot &s = sRing[idx % cRingSize];
+
+	entry.sequence = static_cast<unsigned int>(idx);
+
+	// odd sequence == write in progress.
+	s.sequence.store(idx * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	s.entry = entry;
+	s.sequence.store(idx * 2 + 2, std::memory_order_release);
+}
+
+size_t
+MatchTrace::copyOut(XPMPMatchTrace_t *outEntries, size_t maxEntries)
+{
+	const uint64_t head = sHead.load(std::memory_order_acquire);
+	const uint64_t available = std::min<uint64_t>(head, std::min<uint64_t>(cRingSize, maxEntries));
+
+	size_t copied = 0;
+	for (uint64_t idx = head - available; idx < head; ++idx) {
+		const slot &s = sRing[idx % cRingSize];
+		const uint64_t before = s.sequence.load(std::memory_order_acquire);
+		if (before != idx * 2 + 2) {
+			// still being written, or already overwritten by a newer entry.
+			continue;
+		}
+		outEntries[copied] = s.entry;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (s.sequence.load(std::memory_order_relaxed) != before) {
+			continue;
+		}
+		++copied;
+	}
+	return copied;
+}
+
+void
+MatchTrace::dump()
+{
+	std::vector<XPMPMatchTrace_t> entries(cRingSize);
+	entries.resize(copyOut(entries.data(), entries.size()));
+
+	char buf[256];
+	for (const auto &entry: entries) {
+		const char *modelName = "-";
+		if (entry.model >= 0 && entry.model < static_cast<int>(gCatalog.models.size())) {
+			modelName = gCatalog.models[entry.model]->getModelName().c_str();
+		}
+		snprintf(
+			buf,
+			sizeof(buf),
+			XPMP_CLIENT_NAME " MATCHTRACE %u - %s/%s/%s passes=%04x quality=%d package=%d model=%s time=%uns\n",
+			entry.sequence,
+			entry.icao,
+			entry.airline,
+			entry.livery,
+			entry.passesTried,
+			entry.quality,
+			entry.package,
+			modelName,
+			entry.elapsedNs);
+		XPLMDebugString(buf);
+	}
+}
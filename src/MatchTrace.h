@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef MATCHTRACE_H
+#define MATCHTRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "XPMPMultiplayer.h"
+#include "PlaneType.h"
+
+/** MatchTrace keeps a ring buffer of the most recent model-match attempts.
+ *
+ * Recording is lock-free and cheap enough to be left on permanently.  Each
+ * slot carries a sequence number which is made odd whilst the slot is being
+ * written so readers can detect (and discard) torn entries.
+ */
+class MatchTrace {
+public:
+	/** Builder accumulates the details of a single match attempt.  The entry
+	 * is committed to the ring buffer by calling commit().
+	 */
+	class Builder {
+	public:
+		explicit Builder(const PlaneType &type);
+
+		void passTried(int bit)
+		{
+			mEntry.passesTried |= (1u << bit);
+		}
+
+		void result(int quality, int package, int model)
+		{
+			mEntry.quality = quality;
+			mEntry.package = package;
+			mEntry.model = model;
+		}
+
+		void setQuality(int quality)
+		{
+			mEntry.quality = quality;
+		}
+
+		/** adoptResult takes the package and model matched by another
+		 * attempt, leaving its passes behind.
+		 */
+		void adoptResult(const Builder &other)
+		{
+			mEntry.package = other.mEntry.package;
+			mEntry.model = other.mEntry.model;
+		}
+
+		void commit();
+
+	private:
+		XPMPMatchTrace_t	mEntry;
+		std::chrono::steady_clock::time_point	mStart;
+	};
+
+	/** copies out up to maxEntries of the most recent entries, oldest first.
+	 *
+	 * @return the number of entries copied
+	 */
+	static size_t copyOut(XPMPMatchTrace_t *outEntries, size_t maxEntries);
+
+	/** writes the current contents of the ring buffer to the log. */
+	static void dump();
+
+private:
+	static const size_t				cRingSize = 1024;
+
+	struct slot {
+		std::atomic<uint64_t>	sequence;
+		XPMPMatchTrace_t		entry;
+	};
+
+	static slot						sRing[cRingSize];
+	static std::atomic<uint64_t>	sHead;
+
+	static void record(XPMPMatchTrace_t &entry);
+};
+
+#endif //MATCHTRACE_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/** ObjectPool hands out fixed-size blocks of memory, carving them out of
+ * larger chunks and recycling freed blocks through a free list, so objects
+ * that are created and destroyed often don't churn the heap.
+ *
+ * Chunks are only returned to the heap when the pool is destroyed.
+ *
+ * The pool is not thread-safe.
+ */
+template <size_t BlockSize, size_t BlocksPerChunk = 64>
+class ObjectPool {
+public:
+	ObjectPool() :
+		mFreeList(nullptr),
+		mInUse(0)
+	{
+	}
+
+	~ObjectPool()
+	{
+		for (auto *chunk: mChunks) {
+			::operator delete(chunk);
+		}
+	}
+
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+
+	void *allocate()
+	{
+		if (mFreeList == nullptr) {
+			grow();
+		}
+		block *thisBlock = mFreeList;
+		mFreeList = thisBlock->next;
+		++mInUse;
+		return thisBlock;
+	}
+
+	void deallocate(void *ptr)
+	{
+		if (ptr == nullptr) {
+			return;
+		}
+		auto *thisBlock = static_cast<block *>(ptr);
+		thisBlock->next = mFreeList;
+		mFreeList = thisBlock;
+		--mInUse;
+	}
+
+	/** @return the number of blocks currently allocated from the pool */
+	size_t inUse() const
+	{
+		return mInUse;
+	}
+
+	/** @return the number of blocks the pool has reserved from the heap */
+	size_t capacity() const
+	{
+		return mChunks.size() * BlocksPerChunk;
+	}
+
+private:
+	union block {
+		block *			next;
+		alignas(std::max_align_t) unsigned char	storage[BlockSize];
+	};
+
+	void grow()
+	{
+		auto *chunk = static_cast<block *>(::operator new(sizeof(block) * BlocksPerChunk));
+		mChunks.push_back(chunk);
+		for (size_t i = 0; i < BlocksPerChunk; ++i) {
+			chunk[i].next = mFreeList;
+			mFreeList = &chunk[i];
+		}
+	}
+
+	std::vector<block *>	mChunks;
+	block *					mFreeList;
+	size_t					mInUse;
+};
+
+#endif //OBJECTPOOL_H
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PlaneCommands.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include <XPLMUtilities.h>
+
+#include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
+
+using namespace std;
+
+static std::atomic<std::thread::id>				gSimThread;
+static MPSCQueue<PlaneCommands::command>		gCommandQueue;
+static std::atomic<bool>						gAcceptUpdates(false);
+
+void
+PlaneCommands::setSimThread()
+{
+	gSimThread = this_thread::get_id();
+}
+
+bool
+PlaneCommands::onSimThread()
+{
+	const auto simThread = gSimThread.load();
+	return simThread == thread::id() || simThread == this_thread::get_id();
+}
+
+void
+PlaneCommands::post(command &&cmd)
+{
+	if (cmd.kind == command::type::Update && !gAcceptUpdates.load(std::memory_order_relaxed)) {
+		return;
+	}
+	gCommandQueue.push(std::move(cmd));
+}
+
+static void
+ApplyUpdate(const PlaneCommands::update &thisUpdate)
+{
+	auto *plane = gPlanes.find(thisUpdate.plane);
+	if (plane == nullptr) {
+		return;
+	}
+	if (thisUpdate.hasPosition) {
+		gPlanes.updatePosition(*plane, thisUpdate.position);
+	}
+	if (thisUpdate.hasSurfaces) {
+		plane->updateSurfaces(thisUpdate.surfaces);
+	}
+	if (thisUpdate.hasSurveillance) {
+		plane->updateSurveillance(thisUpdate.surveillance);
+	}
+}
+
+static void
+Apply(PlaneCommands::command &&cmd)
+{
+	typedef PlaneCommands::command::type type;
+
+	switch (cmd.kind) {
+	case type::Create: {
+		// this fails if the plane was destroyed, or all the planes cleared,
+		// before it got this far.
+		auto *plane = gPlanes.commit(cmd.plane, cmd.epoch);
+		if (plane == nullptr) {
+			break;
+		}
+		InitPlane(*plane,
+			cmd.icao.c_str(),
+			cmd.airline.c_str(),
+			cmd.livery.c_str(),
+			cmd.modelName.empty() ? nullptr : cmd.modelName.c_str());
+		break;
+	}
+	case type::Destroy:
+		gPlanes.destroy(cmd.plane);
+		break;
+	case type::Update:
+		for (const auto &thisUpdate: cmd.updates) {
+			ApplyUpdate(thisUpdate);
+		}
+		break;
+	case type::None:
+		break;
+	}
+}
+
+void
+PlaneCommands::drain()
+{
+	gCommandQueue.consume(&Apply);
+}
+
+static void
+Discard(PlaneCommands::command &&cmd)
+{
+	if (cmd.kind == PlaneCommands::command::type::Create) {
+		// give the reserved slot back.
+		gPlanes.destroy(cmd.plane);
+	}
+}
+
+void
+PlaneCommands::start()
+{
+	gAcceptUpdates = true;
+}
+
+void
+PlaneCommands::stop()
+{
+	gAcceptUpdates = false;
+	gCommandQueue.consume(&Discard);
+}
+
+void
+InitPlane(XPMPPlane &plane,
+          const char *icao,
+          const char *airline,
+          const char *livery,
+          const char *modelName)
+{
+	plane.setType(PlaneType(icao, airline, livery));
+	if (modelName == nullptr) {
+		plane.updateCSL();
+		return;
+	}
+
+	// Find the model
+	bool found = false;
+	for (const auto &package : gPackages) {
+		auto cslPlane = std::find_if(package.planes.begin(),
+		                             package.planes.end(),
+		                             [modelName](CSL *p) {
+			                             return p->getModelName() == modelName;
+		                             });
+		if (cslPlane != package.planes.end()) {
+			plane.setCSL(*cslPlane);
+			found = true;
+		}
+	}
+
+	if (!found) {
+		XPLMDebugString("Requested model ");
+		XPLMDebugString(modelName);
+		XPLMDebugString(" is unknown! Falling back to own model matching.");
+		XPLMDebugString("\n");
+		plane.updateCSL();
+	}
+}
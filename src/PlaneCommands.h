@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PLANECOMMANDS_H
+#define PLANECOMMANDS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "XPMPMultiplayer.h"
+
+/** PlaneCommands lets the plane management calls be made from threads
+ * other than the sim thread.
+ *
+ * Calls made from other threads are turned into commands and posted to a
+ * lock-free queue, which is drained on the sim thread at the start of each
+ * frame.  Commands from a single thread are applied in the order they were
+ * posted.
+ *
+ * Whilst multiplayer is disabled nothing drains the queue, so updates posted
+ * then are dropped rather than left to pile up.
+ */
+class PlaneCommands {
+public:
+	struct update {
+		XPMPPlaneID				plane;
+		bool					hasPosition;
+		bool					hasSurfaces;
+		bool					hasSurveillance;
+		XPMPPlanePosition_t		position;
+		XPMPPlaneSurfaces_t		surfaces;
+		XPMPPlaneSurveillance_t	surveillance;
+	};
+
+	struct command {
+		enum class type {
+			None,
+			Create,
+			Destroy,
+			Update,
+		};
+
+		type				kind = type::None;
+		XPMPPlaneID			plane = nullptr;
+
+		// Create
+		uint32_t			epoch = 0;		// the registry's epoch when the plane was reserved
+		std::string			icao;
+		std::string			airline;
+		std::string			livery;
+		std::string			modelName;
+
+		// Update
+		std::vector<update>	updates;
+	};
+
+	/** setSimThread records the calling thread as the sim thread. */
+	static void setSimThread();
+
+	/** @return true if the calling thread is the sim thread (or if it hasn't
+	 *     been set yet)
+	 */
+	static bool onSimThread();
+
+	/** post queues a command to be applied on the sim thread. */
+	static void post(command &&cmd);
+
+	/** drain applies the commands that were queued when it was called.  Sim
+	 * thread only.
+	 */
+	static void drain();
+
+	/** start lets updates be queued again once multiplayer is enabled. */
+	static void start();
+
+	/** stop discards everything queued, cancelling any queued creations, and
+	 * drops updates posted until start() is called.  Sim thread only.
+	 */
+	static void stop();
+};
+
+class XPMPPlane;
+
+/** InitPlane sets up the type and model of a newly created plane.
+ *
+ * If modelName is not null, that model is used if it exists, otherwise
+ * the model is chosen by the normal matching process.
+ */
+void	InitPlane(
+	XPMPPlane &plane,
+	const char *icao,
+	const char *airline,
+	const char *livery,
+	const char *modelName);
+
+#endif //PLANECOMMANDS_H
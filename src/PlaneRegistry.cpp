@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PlaneRegistry.h"
+
+#include <XPLMGraphics.h>
+
+#include "XPMPMultiplayerVars.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+// the radius (in meters) of the sphere tested against the view for each
+// plane - enough for the largest airliner - and how much it grows per meter
+// from the camera, to allow for the camera turning before the frame is drawn.
+static const float cViewRadius = 50.0f;
+static const float cViewMarginPerMeter = 0.1f;
+
+// does a size-keyed structure include the given member?
+#define HAS_MEMBER(s, type, member) \
+	((s).size >= offsetof(type, member) + sizeof((s).member))
+
+PlaneRegistry::PlaneRegistry() :
+	mNextFreshSlot(0),
+	mFreeHead(cNoSlot),
+	mEpoch(0),
+	mLocalGeneration(0)
+{
+}
+
+PlaneRegistry::~PlaneRegistry() = default;
+
+XPMPPlaneID
+PlaneRegistry::makeID(uint32_t slotIdx, uint32_t generation)
+{
+	const uintptr_t id = (static_cast<uintptr_t>(generation) << cIndexBits) | (slotIdx + 1);
+	return reinterpret_cast<XPMPPlaneID>(id);
+}
+
+uint32_t
+PlaneRegistry::slotFor(XPMPPlaneID id)
+{
+	const uintptr_t index = reinterpret_cast<uintptr_t>(id) & cIndexMask;
+	return (index == 0) ? cNoSlot : static_cast<uint32_t>(index - 1);
+}
+
+XPMPPlane &
+PlaneRegistry::create()
+{
+	XPMPPlaneID id;
+	if (mFreeHead != cNoSlot) {
+		const uint32_t slotIdx = mFreeHead;
+		mFreeHead = mSlots[slotIdx].dense;
+		mSlots[slotIdx].dense = cNoSlot;
+		id = makeID(slotIdx, mSlots[slotIdx].generation);
+	} else {
+		id = reserve();
+	}
+	auto *plane = commit(id, epoch());
+	if (plane == nullptr) {
+		// we've exhausted the slots - there's nothing sensible we can do.
+		std::abort();
+	}
+	return *plane;
+}
+
+XPMPPlaneID
+PlaneRegistry::reserve()
+{
+	slotToken token;
+	if (mRecycled.tryPop(token)) {
+		return makeID(token.index, token.generation);
+	}
+	const uint32_t slotIdx = mNextFreshSlot.fetch_add(1, std::memory_order_relaxed);
+	if (slotIdx >= cIndexMask) {
+		return nullptr;
+	}
+	return makeID(slotIdx, 0);
+}
+
+XPMPPlane *
+PlaneRegistry::commit(XPMPPlaneID id, uint32_t epoch)
+{
+	if (epoch != mEpoch.load(std::memory_order_relaxed)) {
+		cancel(id);
+		return nullptr;
+	}
+	const uint32_t slotIdx = slotFor(id);
+	if (slotIdx == cNoSlot) {
+		return nullptr;
+	}
+	if (slotIdx >= mSlots.size()) {
+		if (slotIdx >= mNextFreshSlot.load(std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		mSlots.resize(slotIdx + 1, slot{0, cNoSlot});
+	}
+	auto &thisSlot = mSlots[slotIdx];
+	if (makeID(slotIdx, thisSlot.generation) != id || thisSlot.dense != cNoSlot) {
+		return nullptr;
+	}
+	thisSlot.dense = static_cast<uint32_t>(mPlanes.size());
+	mPlanes.emplace_back(id);
+	mLat.push_back(0.0);
+	mLon.push_back(0.0);
+	mElevation.push_back(0.0);
+	mPitch.push_back(0.0f);
+	mRoll.push_back(0.0f);
+	mHeading.push_back(0.0f);
+	mTracks.emplace_back();
+	mLocalX.push_back(0.0);
+	mLocalY.push_back(0.0);
+	mLocalZ.push_back(0.0);
+	mLocalStale.push_back(1);
+	return &mPlanes.back();
+}
+
+XPMPPlane *
+PlaneRegistry::find(XPMPPlaneID id)
+{
+	const uint32_t slotIdx = slotFor(id);
+	if (slotIdx >= mSlots.size()) {
+		return nullptr;
+	}
+	const auto &thisSlot = mSlots[slotIdx];
+	if (makeID(slotIdx, thisSlot.generation) != id || thisSlot.dense >= mPlanes.size()) {
+		return nullptr;
+	}
+	// free slots reuse dense for the free list, so make sure it really is
+	// ours.
+	auto &plane = mPlanes[thisSlot.dense];
+	return (plane.getID() == id) ? &plane : nullptr;
+}
+
+bool
+PlaneRegistry::destroy(XPMPPlaneID id)
+{
+	if (find(id) == nullptr) {
+		return cancel(id);
+	}
+	const uint32_t slotIdx = slotFor(id);
+	const uint32_t dense = mSlots[slotIdx].dense;
+
+	// fill the hole with the last plane so the storage stays packed.
+	const size_t last = mPlanes.size() - 1;
+	mGrid.remove(dense);
+	if (dense != last) {
+		mGrid.renumber(static_cast<uint32_t>(last), dense);
+		mPlanes[dense] = std::move(mPlanes[last]);
+		mSlots[slotFor(mPlanes[dense].getID())].dense = dense;
+		mLat[dense] = mLat[last];
+		mLon[dense] = mLon[last];
+		mElevation[dense] = mElevation[last];
+		mPitch[dense] = mPitch[last];
+		mRoll[dense] = mRoll[last];
+		mHeading[dense] = mHeading[last];
+		mTracks[dense] = mTracks[last];
+		mLocalX[dense] = mLocalX[last];
+		mLocalY[dense] = mLocalY[last];
+		mLocalZ[dense] = mLocalZ[last];
+		mLocalStale[dense] = mLocalStale[last];
+	}
+	mPlanes.pop_back();
+	mLat.pop_back();
+	mLon.pop_back();
+	mElevation.pop_back();
+	mPitch.pop_back();
+	mRoll.pop_back();
+	mHeading.pop_back();
+	mTracks.pop_back();
+	mLocalX.pop_back();
+	mLocalY.pop_back();
+	mLocalZ.pop_back();
+	mLocalStale.pop_back();
+	release(slotIdx);
+	return true;
+}
+
+void
+PlaneRegistry::clear()
+{
+	for (const auto &plane: mPlanes) {
+		release(slotFor(plane.getID()));
+	}
+	mPlanes.clear();
+	mLat.clear();
+	mLon.clear();
+	mElevation.clear();
+	mPitch.clear();
+	mRoll.clear();
+	mHeading.clear();
+	mTracks.clear();
+	mLocalX.clear();
+	mLocalY.clear();
+	mLocalZ.clear();
+	mLocalStale.clear();
+	mGrid.clear();
+	mEpoch.fetch_add(1, std::memory_order_release);
+}
+
+void
+PlaneRegistry::updateLocal(const LocalTransform &xform)
+{
+	const size_t count = mPlanes.size();
+	if (xform.generation() != mLocalGeneration) {
+		mLocalGeneration = xform.generation();
+		std::fill(mLocalStale.begin(), mLocalStale.end(), 1);
+	}
+
+	mStaleIndex.clear();
+	for (size_t idx = 0; idx < count; ++idx) {
+		if (mLocalStale[idx]) {
+			mStaleIndex.push_back(static_cast<uint32_t>(idx));
+		}
+	}
+	const size_t staleCount = mStaleIndex.size();
+	if (staleCount == 0) {
+		return;
+	}
+
+	mStaleInRange.assign(staleCount, 0);
+	if (xform.isValid()) {
+		mStaleLat.resize(staleCount);
+		mStaleLon.resize(staleCount);
+		mStaleElevation.resize(staleCount);
+		mStaleX.resize(staleCount);
+		mStaleY.resize(staleCount);
+		mStaleZ.resize(staleCount);
+		for (size_t n = 0; n < staleCount; ++n) {
+			const uint32_t idx = mStaleIndex[n];
+			mStaleLat[n] = mLat[idx];
+			mStaleLon[n] = mLon[idx];
+			mStaleElevation[n] = mElevation[idx];
+		}
+		xform.transform(mStaleLat.data(), mStaleLon.data(), mStaleElevation.data(),
+			mStaleX.data(), mStaleY.data(), mStaleZ.data(), mStaleInRange.data(), staleCount);
+	}
+	for (size_t n = 0; n < staleCount; ++n) {
+		const uint32_t idx = mStaleIndex[n];
+		if (mStaleInRange[n]) {
+			mLocalX[idx] = mStaleX[n];
+			mLocalY[idx] = mStaleY[n];
+			mLocalZ[idx] = mStaleZ[n];
+		} else {
+			XPLMWorldToLocal(mLat[idx], mLon[idx], mElevation[idx] * kFtToMeters,
+				&mLocalX[idx], &mLocalY[idx], &mLocalZ[idx]);
+		}
+		mGrid.update(idx, static_cast<float>(mLocalX[idx]), static_cast<float>(mLocalY[idx]),
+			static_cast<float>(mLocalZ[idx]));
+		mLocalStale[idx] = 0;
+	}
+}
+
+void
+PlaneRegistry::updateInView(const CullInfo &camera)
+{
+	const size_t count = mPlanes.size();
+	mViewX.resize(count);
+	mViewY.resize(count);
+	mViewZ.resize(count);
+	mViewRadius.resize(count);
+	mViewDistanceSqr.resize(count);
+	mInView.resize((count + 31) / 32);
+	for (size_t idx = 0; idx < count; ++idx) {
+		mViewX[idx] = static_cast<float>(mLocalX[idx]);
+		mViewY[idx] = static_cast<float>(mLocalY[idx]);
+		mViewZ[idx] = static_cast<float>(mLocalZ[idx]);
+	}
+	camera.SpheresDistanceSqr(mViewX.data(), mViewY.data(), mViewZ.data(), count, mViewDistanceSqr.data());
+	for (size_t idx = 0; idx < count; ++idx) {
+		mViewRadius[idx] = cViewRadius + std::sqrt(mViewDistanceSqr[idx]) * cViewMarginPerMeter;
+	}
+	camera.SpheresVisible(mViewX.data(), mViewY.data(), mViewZ.data(), mViewRadius.data(),
+		count, mInView.data());
+}
+
+void
+PlaneRegistry::markAllDirty()
+{
+	for (auto &plane: mPlanes) {
+		plane.markDirty();
+	}
+}
+
+void
+PlaneRegistry::updatePosition(XPMPPlane &plane, const XPMPPlanePosition_t &position)
+{
+	plane.updatePosition(position);
+
+	const size_t idx = indexOf(plane);
+	if (HAS_MEMBER(position, XPMPPlanePosition_t, timestamp) && position.timestamp > 0.0) {
+		mTracks[idx].push(PositionSample_t{
+			position.timestamp,
+			position.lat, position.lon, position.elevation,
+			position.pitch, position.roll, position.heading,
+		});
+		return;
+	}
+	// an untimed update takes the plane off playback.
+	mTracks[idx].clear();
+	if (HAS_MEMBER(position, XPMPPlanePosition_t, elevation)) {
+		mLat[idx] = position.lat;
+		mLon[idx] = position.lon;
+		mElevation[idx] = position.elevation;
+		mLocalStale[idx] = 1;
+	}
+	if (HAS_MEMBER(position, XPMPPlanePosition_t, heading)) {
+		mPitch[idx] = position.pitch;
+		mRoll[idx] = position.roll;
+		mHeading[idx] = position.heading;
+	}
+}
+
+void
+PlaneRegistry::updateBatch(const XPMPPlaneBatch_t &batch)
+{
+	if (batch.planes == nullptr) {
+		return;
+	}
+	const bool hasSurfaces = (batch.surfaces != nullptr);
+	const bool hasTimestamps = HAS_MEMBER(batch, XPMPPlaneBatch_t, timestamp) && batch.timestamp != nullptr;
+
+	for (size_t n = 0; n < batch.count; ++n) {
+		XPMPPlane *plane = find(batch.planes[n]);
+		if (plane == nullptr) {
+			continue;
+		}
+		const size_t idx = indexOf(*plane);
+		plane->markDirty();
+		if (hasSurfaces) {
+			plane->updateSurfaces(batch.surfaces[n]);
+		}
+		auto &track = mTracks[idx];
+		if (hasTimestamps && batch.timestamp[n] > 0.0) {
+			// anything missing from the report carries over from the last.
+			PositionSample_t sample = track.empty() ? PositionSample_t{
+				0.0,
+				mLat[idx], mLon[idx], mElevation[idx],
+				mPitch[idx], mRoll[idx], mHeading[idx],
+			} : track.newest();
+			sample.timestamp = batch.timestamp[n];
+			if (batch.lat != nullptr) {
+				sample.lat = batch.lat[n];
+			}
+			if (batch.lon != nullptr) {
+				sample.lon = batch.lon[n];
+			}
+			if (batch.elevation != nullptr) {
+				sample.elevation = batch.elevation[n];
+			}
+			if (batch.pitch != nullptr) {
+				sample.pitch = batch.pitch[n];
+			}
+			if (batch.roll != nullptr) {
+				sample.roll = batch.roll[n];
+			}
+			if (batch.heading != nullptr) {
+				sample.heading = batch.heading[n];
+			}
+			track.push(sample);
+			continue;
+		}
+		track.clear();
+		if (batch.lat != nullptr) {
+			mLat[idx] = batch.lat[n];
+		}
+		if (batch.lon != nullptr) {
+			mLon[idx] = batch.lon[n];
+		}
+		if (batch.elevation != nullptr) {
+			mElevation[idx] = batch.elevation[n];
+		}
+		if (batch.lat != nullptr || batch.lon != nullptr || batch.elevation != nullptr) {
+			mLocalStale[idx] = 1;
+		}
+		if (batch.pitch != nullptr) {
+			mPitch[idx] = batch.pitch[n];
+		}
+		if (batch.roll != nullptr) {
+			mRoll[idx] = batch.roll[n];
+		}
+		if (batch.heading != nullptr) {
+			mHeading[idx] = batch.heading[n];
+		}
+	}
+}
+
+void
+PlaneRegistry::advance(double playbackTime, double maxExtrapolation)
+{
+	const size_t count = mPlanes.size();
+	mDeltaLat.assign(count, 0.0);
+	mDeltaLon.assign(count, 0.0);
+	mDeltaElevation.assign(count, 0.0);
+	mDeltaPitch.assign(count, 0.0f);
+	mDeltaRoll.assign(count, 0.0f);
+	mDeltaHeading.assign(count, 0.0f);
+	mFraction.assign(count, 0.0);
+
+	// work out which reports each plane is between, and put it at the first.
+	// This is the only part that has to deal with the tracks individually -
+	// the rest is straight arithmetic over the arrays.
+	bool anyMoving = false;
+	for (size_t idx = 0; idx < count; ++idx) {
+		auto &track = mTracks[idx];
+		if (track.empty() || track.isSettled()) {
+			continue;
+		}
+		const PositionSample_t *from;
+		const PositionSample_t *to;
+		track.bracket(playbackTime, from, to);
+
+		// don't dirty planes that are sitting still where they already are.
+		if (mLat[idx] != from->lat || mLon[idx] != from->lon ||
+			mElevation[idx] != from->elevation || mPitch[idx] != from->pitch ||
+			mRoll[idx] != from->roll || mHeading[idx] != from->heading) {
+			mLat[idx] = from->lat;
+			mLon[idx] = from->lon;
+			mElevation[idx] = from->elevation;
+			mPitch[idx] = from->pitch;
+			mRoll[idx] = from->roll;
+			mHeading[idx] = from->heading;
+			mPlanes[idx].markDirty();
+			mLocalStale[idx] = 1;
+		}
+
+		const bool last = (to == &track.newest());
+		const double span = to->timestamp - from->timestamp;
+		// headings are interpolated the short way round.
+		const float turn = std::remainder(to->heading - from->heading, 360.0f);
+		const bool still = (to->lat == from->lat && to->lon == from->lon &&
+			to->elevation == from->elevation && to->pitch == from->pitch &&
+			to->roll == from->roll && turn == 0.0f);
+		if (span <= 0.0 || still) {
+			if (last) {
+				track.setSettled();
+			}
+			continue;
+		}
+		const double endTime = to->timestamp + maxExtrapolation;
+		if (last && playbackTime >= endTime) {
+			// this is the last we'll move until we hear from it again.
+			track.setSettled();
+		}
+		mPlanes[idx].markDirty();
+		if (to->lat != from->lat || to->lon != from->lon || to->elevation != from->elevation) {
+			mLocalStale[idx] = 1;
+		}
+		mDeltaLat[idx] = to->lat - from->lat;
+		// longitude goes the short way round too, so planes crossing the
+		// antimeridian don't swing back across the whole world.
+		mDeltaLon[idx] = std::remainder(to->lon - from->lon, 360.0);
+		mDeltaElevation[idx] = to->elevation - from->elevation;
+		mDeltaPitch[idx] = to->pitch - from->pitch;
+		mDeltaRoll[idx] = to->roll - from->roll;
+		mDeltaHeading[idx] = turn;
+		mFraction[idx] = (std::max(std::min(playbackTime, endTime), from->timestamp) - from->timestamp) / span;
+		anyMoving = true;
+	}
+	if (!anyMoving) {
+		return;
+	}
+
+	// then move everything along.  Planes that aren't moving have no delta,
+	// so this leaves them exactly where they are.
+	for (size_t idx = 0; idx < count; ++idx) {
+		mLat[idx] += mDeltaLat[idx] * mFraction[idx];
+		mLon[idx] = std::remainder(mLon[idx] + mDeltaLon[idx] * mFraction[idx], 360.0);
+		mElevation[idx] += mDeltaElevation[idx] * mFraction[idx];
+	}
+	for (size_t idx = 0; idx < count; ++idx) {
+		const auto fraction = static_cast<float>(mFraction[idx]);
+		mPitch[idx] += mDeltaPitch[idx] * fraction;
+		mRoll[idx] += mDeltaRoll[idx] * fraction;
+		mHeading[idx] += mDeltaHeading[idx] * fraction;
+		mHeading[idx] -= 360.0f * std::floor(mHeading[idx] / 360.0f);
+	}
+}
+
+bool
+PlaneRegistry::cancel(XPMPPlaneID id)
+{
+	const uint32_t slotIdx = slotFor(id);
+	if (slotIdx == cNoSlot || slotIdx >= mNextFreshSlot.load(std::memory_order_relaxed)) {
+		return false;
+	}
+	if (slotIdx >= mSlots.size()) {
+		mSlots.resize(slotIdx + 1, slot{0, cNoSlot});
+	}
+	const auto &thisSlot = mSlots[slotIdx];
+	if (makeID(slotIdx, thisSlot.generation) != id || thisSlot.dense != cNoSlot) {
+		return false;
+	}
+	release(slotIdx);
+	return true;
+}
+
+void
+PlaneRegistry::release(uint32_t slotIdx)
+{
+	auto &thisSlot = mSlots[slotIdx];
+	++thisSlot.generation;
+	if (mRecycled.tryPush(slotToken{slotIdx, thisSlot.generation})) {
+		thisSlot.dense = cNoSlot;
+	} else {
+		thisSlot.dense = mFreeHead;
+		mFreeHead = slotIdx;
+	}
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PLANEREGISTRY_H
+#define PLANEREGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "XPMPMultiplayer.h"
+#include "XPMPPlane.h"
+#include "LockFreeQueue.h"
+#include "PlaneTrack.h"
+#include "LocalTransform.h"
+#include "CullInfo.h"
+#include "SpatialGrid.h"
+
+/** PlaneRegistry owns all of the planes.
+ *
+ * It's a slot map:  the planes themselves are kept packed together in a
+ * single vector (so the per-frame updates walk contiguous memory), with
+ * a table of slots mapping the handles we give out onto them.
+ *
+ * A handle (XPMPPlaneID) encodes the slot index and the generation of the
+ * slot when the plane was created.  Destroying a plane bumps its slot's
+ * generation, so stale handles can be detected and rejected rather than
+ * dereferenced.
+ *
+ * Planes move when others are destroyed, so pointers to them must not be
+ * kept across calls that create or destroy planes - hang on to the ID
+ * instead.
+ *
+ * Everything other than reserve() must be called from the sim thread.
+ *
+ * The planes' positions and attitudes are kept out of the XPMPPlane records
+ * in structure-of-arrays form, in the same order as the planes, so batched
+ * updates can be written straight in, and the per-frame processing can walk
+ * them as flat arrays.
+ *
+ * Timestamped position updates don't go straight into those arrays - they're
+ * held in a per-plane PlaneTrack, and advance() writes the interpolated
+ * positions in once per frame.
+ *
+ * Each plane's position in local coordinates is cached alongside, and only
+ * recomputed by updateLocal() when the plane moves or the sim shifts its
+ * local coordinate system.  The planes are also filed by those coordinates
+ * in a SpatialGrid, which is kept up to date the same way, for finding the
+ * planes near somewhere without going through all of them.
+ */
+class PlaneRegistry {
+public:
+	typedef std::vector<XPMPPlane>::iterator	iterator;
+
+	PlaneRegistry();
+	~PlaneRegistry();
+
+	/** create allocates a new plane.
+	 *
+	 * @return the new plane.  Use XPMPPlane::getID() to get its handle.
+	 */
+	XPMPPlane &create();
+
+	/** reserve allocates a handle for a plane without creating it.
+	 *
+	 * This is safe to call from any thread.  The handle stays invalid until
+	 * the plane is created by passing it to commit() on the sim thread.
+	 *
+	 * @return the new handle, or nullptr if we've run out of slots.
+	 */
+	XPMPPlaneID reserve();
+
+	/** commit creates a plane for a handle returned by reserve().
+	 *
+	 * @param epoch the value of epoch() from before the handle was reserved.
+	 *     If the registry has been cleared since, the reservation is
+	 *     cancelled rather than committed.
+	 * @return the new plane, or nullptr if the handle wasn't reserved, or its
+	 *     reservation has been cancelled.
+	 */
+	XPMPPlane *commit(XPMPPlaneID id, uint32_t epoch);
+
+	/** @return the number of times the registry has been cleared.  This is
+	 *     safe to call from any thread.
+	 */
+	uint32_t epoch() const
+	{
+		return mEpoch.load(std::memory_order_acquire);
+	}
+
+	/** find looks up a plane by its handle.
+	 *
+	 * @return the plane, or nullptr if the handle is invalid or the plane has
+	 *     since been destroyed.
+	 */
+	XPMPPlane *find(XPMPPlaneID id);
+
+	/** destroy destroys the plane with the given handle.
+	 *
+	 * If the handle has been reserved but not yet committed, the reservation
+	 * is cancelled instead, so the plane is never created.
+	 *
+	 * @return true if the plane was destroyed or its reservation cancelled,
+	 *     false if the handle was invalid or stale.
+	 */
+	bool destroy(XPMPPlaneID id);
+
+	/** clear destroys all the planes. */
+	void clear();
+
+	/** markAllDirty forces every plane to be fully updated on the next
+	 * frame - for when something they all depend on has changed.
+	 */
+	void markAllDirty();
+
+	size_t size() const
+	{
+		return mPlanes.size();
+	}
+
+	bool empty() const
+	{
+		return mPlanes.empty();
+	}
+
+	iterator begin()
+	{
+		return mPlanes.begin();
+	}
+
+	iterator end()
+	{
+		return mPlanes.end();
+	}
+
+	/** @return the plane at the given dense index (0 to size()-1) */
+	XPMPPlane &at(size_t idx)
+	{
+		return mPlanes[idx];
+	}
+
+	const XPMPPlane &at(size_t idx) const
+	{
+		return mPlanes[idx];
+	}
+
+	/** @return the dense index of a plane held by the registry */
+	size_t indexOf(const XPMPPlane &plane) const
+	{
+		return static_cast<size_t>(&plane - mPlanes.data());
+	}
+
+	/** @return the position and attitude of the plane at the given dense
+	 *     index.
+	 */
+	PlaneKinematics_t kinematicsAt(size_t idx) const
+	{
+		return PlaneKinematics_t{
+			mLat[idx], mLon[idx], mElevation[idx],
+			mPitch[idx], mRoll[idx], mHeading[idx]
+		};
+	}
+
+	/** updatePosition applies a (size-keyed) position update to a plane.
+	 *
+	 * If the update is timestamped, it's added to the plane's track instead
+	 * of taking effect immediately.
+	 */
+	void updatePosition(XPMPPlane &plane, const XPMPPlanePosition_t &position);
+
+	/** updateBatch applies a structure-of-arrays batch update.
+	 *
+	 * Stale or null plane IDs in the batch are skipped.
+	 */
+	void updateBatch(const XPMPPlaneBatch_t &batch);
+
+	/** advance sets the position of every plane with a track to where it
+	 * was at the given time, extrapolating forwards from the last two reports
+	 * if they're older than that.
+	 *
+	 * @param playbackTime the time to play back, on the XPMPGetTimestamp clock
+	 * @param maxExtrapolation the maximum time to extrapolate beyond the
+	 *     newest report - after that, the plane stops.
+	 */
+	void advance(double playbackTime, double maxExtrapolation);
+
+	/** updateLocal brings the cached local coordinates up to date.
+	 *
+	 * Only the planes that have moved since the last call are converted,
+	 * unless the transform's generation has changed, in which case they all
+	 * are.  Planes the transform can't handle (or all of them, if it isn't
+	 * valid) are converted with XPLMWorldToLocal.  Sim thread only.
+	 */
+	void updateLocal(const LocalTransform &xform);
+
+	/** localAt gets the local coordinates of a plane as of the last
+	 * updateLocal.
+	 *
+	 * @param idx the index of the plane
+	 * @param outLocal set to the x, y & z coordinates
+	 */
+	void localAt(size_t idx, double outLocal[3]) const
+	{
+		outLocal[0] = mLocalX[idx];
+		outLocal[1] = mLocalY[idx];
+		outLocal[2] = mLocalZ[idx];
+	}
+
+	/** grid gets the spatial index of the planes, by their local
+	 * coordinates as of the last updateLocal.  The items it gives back are
+	 * the planes' dense indices.
+	 */
+	const SpatialGrid &grid() const
+	{
+		return mGrid;
+	}
+
+	/** updateInView works out which planes are within the camera's view, for
+	 * inViewAt to return, from the local coordinates as of the last
+	 * updateLocal.
+	 *
+	 * Planes are tested as spheres big enough for any aircraft, grown with
+	 * distance to allow for the camera moving between now and the frame
+	 * being drawn.
+	 */
+	void updateInView(const CullInfo &camera);
+
+	/** @return true if the plane at the given index was in view as of the
+	 *     last updateInView.
+	 */
+	bool inViewAt(size_t idx) const
+	{
+		return (mInView[idx / 32] >> (idx % 32)) & 1u;
+	}
+
+	/** @return the square of the distance from the camera to the plane at
+	 *     the given index, as of the last updateInView.
+	 */
+	float distanceSqrAt(size_t idx) const
+	{
+		return mViewDistanceSqr[idx];
+	}
+
+private:
+	// the handle's lower bits hold the slot index (+1, so no handle is ever
+	// null), the remaining bits hold the generation.
+	static const unsigned		cIndexBits = 24;
+	static const uintptr_t		cIndexMask = (uintptr_t(1) << cIndexBits) - 1;
+	static const uint32_t		cNoSlot = UINT32_MAX;
+	static const size_t			cRecycleQueueSize = 1024;
+
+	struct slot {
+		uint32_t	generation;
+		uint32_t	dense;		// index into mPlanes if live, the next free slot if on mFreeHead, or cNoSlot.
+	};
+
+	// a free slot, as handed between threads.
+	struct slotToken {
+		uint32_t	index;
+		uint32_t	generation;
+	};
+
+	static XPMPPlaneID makeID(uint32_t slotIdx, uint32_t generation);
+	static uint32_t slotFor(XPMPPlaneID id);
+
+	void release(uint32_t slotIdx);
+
+	// gives up a handle that was reserved but never committed, so commit()
+	// will reject it and the slot can be reused.  Returns false if the
+	// handle isn't a pending reservation.
+	bool cancel(XPMPPlaneID id);
+
+	std::vector<slot>		mSlots;
+	std::vector<XPMPPlane>	mPlanes;
+
+	// Released slots go onto mRecycled so reserve() can reuse them from any
+	// thread.  If that's full, they go on the sim-thread only free list
+	// instead.  Slots that have never been used are handed out from
+	// mNextFreshSlot - mSlots is grown to cover them as they're committed.
+	BoundedQueue<slotToken, cRecycleQueueSize>	mRecycled;
+	std::atomic<uint32_t>	mNextFreshSlot;
+	uint32_t				mFreeHead;
+
+	// bumped by clear(), so creations queued before it can be told apart.
+	std::atomic<uint32_t>	mEpoch;
+
+	// kinematic state, indexed the same as mPlanes
+	std::vector<double>		mLat;
+	std::vector<double>		mLon;
+	std::vector<double>		mElevation;
+	std::vector<float>		mPitch;
+	std::vector<float>		mRoll;
+	std::vector<float>		mHeading;
+
+	// jitter buffers for timestamped updates, indexed the same as mPlanes
+	std::vector<PlaneTrack>	mTracks;
+
+	// per-frame scratch for advance() - the change from each plane's current
+	// position, and how far along it to go.
+	std::vector<double>		mDeltaLat;
+	std::vector<double>		mDeltaLon;
+	std::vector<double>		mDeltaElevation;
+	std::vector<float>		mDeltaPitch;
+	std::vector<float>		mDeltaRoll;
+	std::vector<float>		mDeltaHeading;
+	std::vector<double>		mFraction;
+
+	// cached local coordinates, indexed the same as mPlanes.  mLocalStale is
+	// set whenever the position changes, and mLocalGeneration is the
+	// generation of the transform they were all last converted with.
+	std::vector<double>		mLocalX;
+	std::vector<double>		mLocalY;
+	std::vector<double>		mLocalZ;
+	std::vector<uint8_t>	mLocalStale;
+	uint32_t				mLocalGeneration;
+
+	// the planes filed by their cached local coordinates.
+	SpatialGrid				mGrid;
+
+	// scratch for updateLocal - the stale planes, packed together so they can
+	// be converted in one go.
+	std::vector<uint32_t>	mStaleIndex;
+	std::vector<double>		mStaleLat;
+	std::vector<double>		mStaleLon;
+	std::vector<double>		mStaleElevation;
+	std::vector<double>		mStaleX;
+	std::vector<double>		mStaleY;
+	std::vector<double>		mStaleZ;
+	std::vector<uint8_t>	mStaleInRange;
+
+	// scratch for updateInView, and its results - the distances, and which
+	// planes are in view as a bitmask.
+	std::vector<float>		mViewX;
+	std::vector<float>		mViewY;
+	std::vector<float>		mViewZ;
+	std::vector<float>		mViewRadius;
+	std::vector<float>		mViewDistanceSqr;
+	std::vector<uint32_t>	mInView;
+};
+
+extern PlaneRegistry		gPlanes;				// All planes
+
+#endif //PLANEREGISTRY_H
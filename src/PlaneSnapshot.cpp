@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PlaneSnapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CSL.h"
+#include "PlaneRegistry.h"
+
+PlaneSnapshot::buffer		PlaneSnapshot::sBuffers[cBufferCount];
+std::atomic<int>			PlaneSnapshot::sReaders[cBufferCount];
+std::atomic<int>			PlaneSnapshot::sLatest(-1);
+
+void
+PlaneSnapshot::publish()
+{
+	// find a buffer that's neither the latest, nor being read.  Readers only
+	// ever pin the latest, so once we've found one, it's ours until we make
+	// it the latest.
+	const int latest = sLatest.load();
+	int target = -1;
+	for (int i = 0; i < cBufferCount; ++i) {
+		if (i != latest && sReaders[i].load() == 0) {
+			target = i;
+			break;
+		}
+	}
+	if (target < 0) {
+		return;
+	}
+
+	auto &buf = sBuffers[target];
+	buf.timestamp = XPMPGetTimestamp();
+	buf.planes.resize(gPlanes.size());
+	for (size_t idx = 0; idx < gPlanes.size(); ++idx) {
+		const auto &plane = gPlanes.at(idx);
+		const auto kinematics = gPlanes.kinematicsAt(idx);
+		auto &out = buf.planes[idx];
+
+		out.plane = plane.getID();
+		out.lat = kinematics.lat;
+		out.lon = kinematics.lon;
+		out.elevation = kinematics.elevation;
+		out.localX = plane.mLocalX;
+		out.localY = plane.mLocalY;
+		out.localZ = plane.mLocalZ;
+		if (plane.mInstanceData != nullptr) {
+			out.distance = std::sqrt(plane.mInstanceData->mDistanceSqr);
+			out.culled = plane.mInstanceData->mCulled;
+		} else {
+			// not rendered at all.
+			out.distance = 0.0f;
+			out.culled = true;
+		}
+		out.matchQuality = plane.mMatchQuality;
+		out.modelName[0] = '\0';
+		if (plane.mCSL != nullptr) {
+			std::strncpy(out.modelName, plane.mCSL->getModelName().c_str(), sizeof(out.modelName) - 1);
+			out.modelName[sizeof(out.modelName) - 1] = '\0';
+		}
+	}
+	sLatest.store(target);
+}
+
+size_t
+PlaneSnapshot::copy(XPMPPlaneSnapshot_t *outPlanes, size_t elementSize, size_t maxPlanes, double *outTimestamp)
+{
+	// pin the latest buffer - if it stopped being the latest before we
+	// pinned it, the sim thread may be refilling it, so try again.
+	int idx;
+	for (;;) {
+		idx = sLatest.load();
+		if (idx < 0) {
+			if (outTimestamp != nullptr) {
+				*outTimestamp = 0.0;
+			}
+			return 0;
+		}
+		sReaders[idx].fetch_add(1);
+		if (sLatest.load() == idx) {
+			break;
+		}
+		sReaders[idx].fetch_sub(1);
+	}
+
+	const auto &buf = sBuffers[idx];
+	const size_t copySize = std::min(elementSize, sizeof(XPMPPlaneSnapshot_t));
+	const size_t count = std::min(maxPlanes, buf.planes.size());
+	auto *ptr = reinterpret_cast<char *>(outPlanes);
+	for (size_t n = 0; n < count; ++n) {
+		std::memcpy(ptr + (n * elementSize), &buf.planes[n], copySize);
+	}
+	if (outTimestamp != nullptr) {
+		*outTimestamp = buf.timestamp;
+	}
+	const size_t total = buf.planes.size();
+
+	sReaders[idx].fetch_sub(1);
+	return total;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PLANESNAPSHOT_H
+#define PLANESNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "XPMPMultiplayer.h"
+
+/** PlaneSnapshot publishes a copy of the planes' state each frame for
+ * other threads to read.
+ *
+ * It's triple buffered - the sim thread fills a buffer nobody is reading and
+ * then makes it the latest, and readers pin whichever buffer is latest while
+ * they copy it out.  Neither side ever waits for the other.  If readers are
+ * holding every buffer the sim thread could use, that frame's snapshot is
+ * skipped.
+ */
+class PlaneSnapshot {
+public:
+	/** publish captures the state of all the planes as of the end of the
+	 * frame.  Sim thread only.
+	 */
+	static void publish();
+
+	/** copy copies the latest snapshot out.  This may be called from any
+	 * thread.
+	 *
+	 * @param outPlanes the array to copy into
+	 * @param elementSize the size of a single element of outPlanes
+	 * @param maxPlanes the number of elements in outPlanes
+	 * @param outTimestamp if not null, is set to when the snapshot was taken
+	 * @return the number of planes in the snapshot
+	 */
+	static size_t copy(XPMPPlaneSnapshot_t *outPlanes, size_t elementSize, size_t maxPlanes, double *outTimestamp);
+
+private:
+	static const int	cBufferCount = 3;
+
+	struct buffer {
+		std::vector<XPMPPlaneSnapshot_t>	planes;
+		double								timestamp = 0.0;
+	};
+
+	static buffer				sBuffers[cBufferCount];
+	static std::atomic<int>		sReaders[cBufferCount];
+	static std::atomic<int>		sLatest;	// -1 until the first publish
+};
+
+#endif //PLANESNAPSHOT_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PlaneTrack.h"
+
+PlaneTrack::PlaneTrack() :
+	mSamples{},
+	mFirst(0),
+	mCount(0),
+	mSettled(false)
+{
+}
+
+bool
+PlaneTrack::push(const PositionSample_t &sample)
+{
+	if (mCount > 0 && sample.timestamp <= newest().timestamp) {
+		return false;
+	}
+	if (mCount == cCapacity) {
+		mFirst = (mFirst + 1) % cCapacity;
+		--mCount;
+	}
+	mSamples[(mFirst + mCount) % cCapacity] = sample;
+	++mCount;
+	mSettled = false;
+	return true;
+}
+
+const PositionSample_t &
+PlaneTrack::newest() const
+{
+	return at(mCount - 1);
+}
+
+void
+PlaneTrack::bracket(double t, const PositionSample_t *&from, const PositionSample_t *&to) const
+{
+	if (mCount == 1 || t <= at(0).timestamp) {
+		from = to = &at(0);
+		return;
+	}
+	size_t n = 1;
+	while (n < mCount - 1 && at(n).timestamp <= t) {
+		++n;
+	}
+	from = &at(n - 1);
+	to = &at(n);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PLANETRACK_H
+#define PLANETRACK_H
+
+#include <cstddef>
+
+/** PositionSample_t is a single timestamped position report for a plane. */
+struct PositionSample_t {
+	double	timestamp;	// seconds, on the XPMPGetTimestamp clock
+	double	lat;
+	double	lon;
+	double	elevation;	// feet
+	float	pitch;
+	float	roll;
+	float	heading;
+};
+
+/** PlaneTrack is the jitter buffer for a single plane - the last few
+ * timestamped position reports, in time order.
+ *
+ * Reports are played back a fixed delay behind real time, so there's
+ * (usually) a report either side of the playback time to interpolate
+ * between, regardless of how unevenly they arrive.
+ */
+class PlaneTrack {
+public:
+	static const size_t cCapacity = 8;
+
+	PlaneTrack();
+
+	/** push adds a report to the track.
+	 *
+	 * Reports that are no newer than the newest we already have are dropped,
+	 * as are the oldest reports once the track is full.
+	 *
+	 * @return true if the report was kept.
+	 */
+	bool push(const PositionSample_t &sample);
+
+	void clear()
+	{
+		mCount = 0;
+		mSettled = false;
+	}
+
+	bool empty() const
+	{
+		return mCount == 0;
+	}
+
+	/** newest returns the most recent report.  The track must not be empty. */
+	const PositionSample_t &newest() const;
+
+	/** bracket finds the reports to interpolate (or extrapolate) between to
+	 * get the position at the given time.
+	 *
+	 * If the time is before the oldest report, or there's only one report,
+	 * from and to are the same report.  If it's after the newest, they're the
+	 * newest two.  The track must not be empty.
+	 */
+	void bracket(double t, const PositionSample_t *&from, const PositionSample_t *&to) const;
+
+	/** a track is settled once the plane has been put at its final position
+	 * for the reports it has - ie: it's stopped, or run out of
+	 * extrapolation.  Pushing a new report unsettles it.
+	 */
+	bool isSettled() const
+	{
+		return mSettled;
+	}
+
+	void setSettled()
+	{
+		mSettled = true;
+	}
+
+private:
+	const PositionSample_t &at(size_t n) const
+	{
+		return mSamples[(mFirst + n) % cCapacity];
+	}
+
+	PositionSample_t	mSamples[cCapacity];
+	size_t				mFirst;
+	size_t				mCount;
+	bool				mSettled;
+};
+
+#endif //PLANETRACK_H
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "RematchSweep.h"
+
+#include <algorithm>
+
+#include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
+#include "CSLLibrary.h"
+#include "FrameBudget.h"
+#include "WorkerPool.h"
+#include "XUtils.h"
+
+using namespace std;
+
+// don't bother spinning up another worker for fewer planes than this.
+static const size_t cPlanesPerWorker = 32;
+
+RematchSweep::state					RematchSweep::sState = RematchSweep::state::Idle;
+unsigned							RematchSweep::sGeneration = 0;
+bool								RematchSweep::sRestart = false;
+bool								RematchSweep::sDefaultChanged = false;
+bool								RematchSweep::sTakeEqual = false;
+std::vector<RematchSweep::job>		RematchSweep::sJobs;
+size_t								RematchSweep::sApplyNext = 0;
+size_t								RematchSweep::sApplied = 0;
+std::atomic<size_t>					RematchSweep::sMatchNext(0);
+std::atomic<bool>					RematchSweep::sCancelled(false);
+unsigned							RematchSweep::sActiveWorkers = 0;
+std::mutex							RematchSweep::sWorkerLock;
+std::condition_variable				RematchSweep::sWorkersDone;
+
+void
+RematchSweep::update()
+{
+	if (sRestart || sGeneration != gCatalog.generation) {
+		cancel();
+		sRestart = false;
+		sGeneration = gCatalog.generation;
+		start();
+		return;
+	}
+	if (sState == state::Matching) {
+		{
+			lock_guard<mutex> lock(sWorkerLock);
+			if (sActiveWorkers > 0) {
+				return;
+			}
+		}
+		sState = state::Applying;
+		sApplyNext = 0;
+		sApplied = 0;
+	}
+	if (sState == state::Applying) {
+		apply();
+	}
+}
+
+void
+RematchSweep::cancel()
+{
+	if (sState == state::Idle) {
+		return;
+	}
+	if (sState == state::Matching) {
+		sCancelled = true;
+		unique_lock<mutex> lock(sWorkerLock);
+		sWorkersDone.wait(lock, [] { return sActiveWorkers == 0; });
+	}
+	sJobs.clear();
+	sState = state::Idle;
+	// the catalog may not actually change, so make sure the sweep we've just
+	// thrown away is redone.
+	sRestart = true;
+}
+
+void
+RematchSweep::defaultChanged()
+{
+	cancel();
+	sRestart = true;
+	sDefaultChanged = true;
+}
+
+void
+RematchSweep::start()
+{
+	sTakeEqual = sDefaultChanged;
+	sDefaultChanged = false;
+	if (gConfiguration.rematchSwapsPerFrame <= 0 || gCatalog.models.empty()) {
+		return;
+	}
+
+	sJobs.clear();
+	for (auto &plane: gPlanes) {
+		// it can't get any better than a perfect match.
+		if (plane.getMatchQuality() == 0) {
+			continue;
+		}
+		sJobs.push_back(job{plane.getID(), plane.getType(), nullptr, -1});
+	}
+	if (sJobs.empty()) {
+		return;
+	}
+
+	auto &pool = WorkerPool::get();
+	const auto workers = static_cast<unsigned>(
+		min<size_t>(pool.size(), (sJobs.size() + cPlanesPerWorker - 1) / cPlanesPerWorker));
+
+	sMatchNext = 0;
+	sCancelled = false;
+	sActiveWorkers = workers;
+	sState = state::Matching;
+	for (unsigned i = 0; i < workers; ++i) {
+		pool.submit(&RematchSweep::matchWorker);
+	}
+}
+
+void
+RematchSweep::matchWorker()
+{
+	const size_t count = sJobs.size();
+	while (!sCancelled) {
+		const size_t idx = sMatchNext.fetch_add(1);
+		if (idx >= count) {
+			break;
+		}
+		auto &thisJob = sJobs[idx];
+		thisJob.newCSL = CSL_MatchPlane(thisJob.type, &thisJob.newQuality, true, true);
+	}
+
+	lock_guard<mutex> lock(sWorkerLock);
+	if (--sActiveWorkers == 0) {
+		sWorkersDone.notify_all();
+	}
+}
+
+void
+RematchSweep::apply()
+{
+	// the swaps can wait until we're not pressed for time.
+	if (gFrameBudget.overran()) {
+		return;
+	}
+	int budget = gConfiguration.rematchSwapsPerFrame;
+	while (budget > 0 && sApplyNext < sJobs.size()) {
+		const auto &thisJob = sJobs[sApplyNext++];
+		if (thisJob.newCSL == nullptr) {
+			continue;
+		}
+		// the plane may have been destroyed or changed type whilst we were
+		// matching.  offerCSL decides if the new match is any better.
+		XPMPPlane *plane = gPlanes.find(thisJob.plane);
+		if (plane == nullptr || plane->getType() != thisJob.type) {
+			continue;
+		}
+		if (plane->offerCSL(thisJob.newCSL, thisJob.newQuality, sTakeEqual)) {
+			++sApplied;
+			--budget;
+		}
+	}
+
+	if (sApplyNext >= sJobs.size()) {
+		if (gConfiguration.debug.modelMatching) {
+			XPLMDump() << XPMP_CLIENT_NAME " MATCH - Catalog re-match changed the model of "
+				<< sApplied << " of " << sJobs.size() << " planes\n";
+		}
+		sJobs.clear();
+		sState = state::Idle;
+	}
+}
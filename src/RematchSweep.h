@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef REMATCHSWEEP_H
+#define REMATCHSWEEP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "XPMPMultiplayer.h"
+#include "PlaneType.h"
+
+class CSL;
+
+/** RematchSweep re-matches the live planes whenever the model catalog
+ * changes, so planes created before a package was loaded can pick up better
+ * models from it.
+ *
+ * The matching is done on the WorkerPool.  Only planes whose match quality
+ * improves are changed, and the changes are applied a few per frame (see
+ * XPMPConfiguration_t::rematchSwapsPerFrame) to avoid a hitch as the new
+ * instances are created.  They're held back altogether after a frame that
+ * ran over its FrameBudget.
+ */
+class RematchSweep {
+public:
+	/** update starts, monitors and applies the results of sweeps.
+	 *
+	 * Call once per frame from the sim thread.
+	 */
+	static void update();
+
+	/** cancel abandons any sweep in progress, waiting for the workers to
+	 * stop.
+	 *
+	 * This must be called before modifying any of the data used for matching
+	 * (gPackages, gGroupings, gAircraftCodes).
+	 */
+	static void cancel();
+
+	/** defaultChanged re-matches the live planes after the default plane
+	 * has changed.
+	 *
+	 * This must be called (from the sim thread) in place of cancel() before
+	 * gDefaultPlane is modified.  Planes whose model came from the old
+	 * default are moved onto the new one, so unlike the catalog sweeps,
+	 * planes are switched to a different model that's as good a match.
+	 */
+	static void defaultChanged();
+
+private:
+	struct job {
+		XPMPPlaneID	plane;
+		PlaneType	type;
+		CSL *		newCSL;
+		int			newQuality;
+	};
+
+	enum class state {
+		Idle,
+		Matching,
+		Applying,
+	};
+
+	static void start();
+	static void matchWorker();
+	static void apply();
+
+	static state					sState;
+	static unsigned					sGeneration;
+	static bool						sRestart;
+	static bool						sDefaultChanged;	// the next sweep takes equal matches
+	static bool						sTakeEqual;			// this sweep takes equal matches
+	static std::vector<job>			sJobs;
+	static size_t					sApplyNext;
+	static size_t					sApplied;
+
+	// shared with the workers whilst Matching
+	static std::atomic<size_t>		sMatchNext;
+	static std::atomic<bool>		sCancelled;
+	static unsigned					sActiveWorkers;
+	static std::mutex				sWorkerLock;
+	static std::condition_variable	sWorkersDone;
+};
+
+#endif //REMATCHSWEEP_H
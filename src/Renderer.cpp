@@ -30,28 +30,42 @@
 #include <XPLMCamera.h>
 
 #include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
+#include "PlaneCommands.h"
+#include "PlaneSnapshot.h"
 #include "TCASOverride.h"
+#include "RematchSweep.h"
+#include "WorkerPool.h"
+#include "LocalTransform.h"
+#include "UpdateScheduler.h"
+#include "FrameBudget.h"
+#include "LODController.h"
 
 using namespace std;
 
-XPLMDataRef gVisDataRef = nullptr;    // Current air visiblity for culling.
-XPLMProbeRef gTerrainProbe = nullptr;
+TerrainCache gTerrainCache;
+
+static LocalTransform gLocalTransform;
+static UpdateScheduler gUpdateScheduler;
+
+// below this many planes, the prepare stage isn't worth farming out to the
+// worker threads.  It's also the number each worker takes at a time.
+static const size_t cParallelPrepareGrain = 256;
+
+// planes that haven't changed are still fully refreshed once every this many
+// frames (staggered across the planes) so things we can't see change - like
+// the terrain under them - eventually get picked up.
+static const unsigned cRefreshInterval = 64;
+
+// scratch for Render_UpdateTCAS.
+static std::vector<uint32_t> gTCASNearest;
 
 void
 Renderer_Init()
 {
     // SETUP - mostly just fetch datarefs.
-    gVisDataRef = XPLMFindDataRef("sim/graphics/view/visibility_effective_m");
-    if (gVisDataRef == nullptr) {
-        gVisDataRef = XPLMFindDataRef("sim/weather/visibility_effective_m");
-    }
-    if (gVisDataRef == nullptr) {
-        XPLMDebugString(
-            "WARNING: Default renderer could not find effective visibility in the sim.\n");
-    }
-
-    gTerrainProbe = XPLMCreateProbe(xplm_ProbeY);
-    CullInfo::init();
+    FrameContext::init();
+    gTerrainCache.init();
     TCAS::Init();
 
 #if RENDERER_STATS
@@ -72,6 +86,7 @@ Renderer_Init()
 
 double Render_FullPlaneDistance = 0.0;
 
+
 void
 Render_PrepLists()
 {
@@ -83,27 +98,118 @@ Render_PrepLists()
     }
     rendLastCycle = thisCycle;
 
-    TCAS::cleanFrame();
+    // if the sim has shifted its local coordinate system, every local
+    // position we hold is wrong - updateLocal will convert them all again,
+    // but the planes have to be repositioned too.
+    if (gLocalTransform.update()) {
+        gPlanes.markAllDirty();
+    }
+
+    Render_PrepFrame(FrameContext::capture(thisCycle, gLocalTransform.generation()));
+}
+
+/*
+ * Render_UpdateTCAS
+ *
+ * TCAS only gets told about the nearest planes, so rather than sort them
+ * all, we ask the spatial grid for the nearest few.  Some of those might not
+ * have an instance (yet) to report on, or be turned away by TCAS, in which
+ * case we go back for more.
+ */
+static void
+Render_UpdateTCAS(const FrameContext &frame)
+{
+    const size_t wanted = TCAS::capacity();
+    for (size_t asked = wanted; ; asked *= 2) {
+        TCAS::cleanFrame();
+        gPlanes.grid().queryNearest(frame.camera.x, frame.camera.y, frame.camera.z, asked, gTCASNearest);
+        size_t added = 0;
+        for (const auto idx: gTCASNearest) {
+            if (gPlanes.at(idx).addToTCAS(gPlanes.kinematicsAt(idx)) && ++added == wanted) {
+                break;
+            }
+        }
+        if (added == wanted || gTCASNearest.size() < asked) {
+            break;
+        }
+    }
+    TCAS::pushPlanes();
+}
+
+void
+Render_PrepFrame(const FrameContext &frame)
+{
+    gFrameBudget.begin(gConfiguration.frameBudget);
+
+    // apply anything that was posted from other threads.
+    PlaneCommands::drain();
+
+    // and move the planes we're playing back along.
+    gPlanes.advance(frame.timestamp - gConfiguration.interpolationDelay,
+                    gConfiguration.maxExtrapolation);
+
+    RematchSweep::update();
 
     if (gPlanes.empty()) {
+        PlaneSnapshot::publish();
+        gFrameBudget.end();
         return;
     }
 
-    // get our view information
-    CullInfo gl_camera;
-    XPLMCameraPosition_t x_camera;
-    XPLMReadCameraPosition(&x_camera);    // only for zoom!
-
     // Culling - read the camera pos and figure out what's visible.
-    //double maxDist = XPLMGetDataf(gVisDataRef);
-    Render_FullPlaneDistance = x_camera.zoom * (5280.0 / 3.2) *
+    Render_FullPlaneDistance = frame.camera.zoom * (5280.0 / 3.2) *
                                gConfiguration.maxFullAircraftRenderingDistance;    // Only draw planes fully within 3 miles.
 
-    for (auto &planePair: gPlanes) {
-        planePair.second->doInstanceUpdate(gl_camera);
+    // only the planes that have moved (or all of them, if the local
+    // coordinate system has shifted) need converting.
+    gPlanes.updateLocal(gLocalTransform);
+    gTerrainCache.beginFrame(frame);
+
+    // the planes are updated in three stages:  first, the ones that have
+    // moved are placed in the world, which needs the XPLM.  Then the
+    // distances, culling, level of detail and animation are worked out,
+    // which doesn't, so is done on the worker threads if there's enough to
+    // do.  Finally, the updates that are needed are pushed into the sim.
+    //
+    // Only the nearest planes are fully updated every frame - the rest are
+    // spread out over several, as decided by the UpdateScheduler.  The
+    // planes are taken nearest tier first, so once the frame's run out of
+    // time, the rest can put off what they can.
+    gPlanes.updateInView(frame.cullInfo);
+    gLODController.update(frame, gFrameBudget.lastDuration(), gPlanes);
+    gUpdateScheduler.beginFrame(frame, gPlanes);
+    const auto &order = gUpdateScheduler.order();
+    const size_t planeCount = gPlanes.size();
+    const unsigned refreshPhase = static_cast<unsigned>(frame.cycle) % cRefreshInterval;
+    for (const auto idx: order) {
+        auto &plane = gPlanes.at(idx);
+        const bool forceRefresh = (idx % cRefreshInterval) == refreshPhase;
+        const auto tier = gUpdateScheduler.tierAt(idx);
+        const bool overBudget = (tier != UpdateScheduler::Near) && gFrameBudget.exhausted();
+        double local[3];
+        gPlanes.localAt(idx, local);
+        plane.beginUpdate(local, forceRefresh, gUpdateScheduler.modeFor(plane.getID(), tier), overBudget);
     }
 
-    TCAS::pushPlanes();
+    auto prepare = [&frame](size_t begin, size_t end) {
+        for (size_t idx = begin; idx < end; ++idx) {
+            gPlanes.at(idx).prepareUpdate(frame, gPlanes.kinematicsAt(idx));
+        }
+    };
+    if (planeCount > cParallelPrepareGrain) {
+        WorkerPool::get().parallelFor(planeCount, cParallelPrepareGrain, prepare);
+    } else {
+        prepare(0, planeCount);
+    }
+
+    for (const auto idx: order) {
+        const bool overBudget = (gUpdateScheduler.tierAt(idx) != UpdateScheduler::Near) && gFrameBudget.exhausted();
+        gPlanes.at(idx).finishUpdate(overBudget);
+    }
+
+    Render_UpdateTCAS(frame);
+    PlaneSnapshot::publish();
+    gFrameBudget.end();
 }
 
 
@@ -31,8 +31,10 @@
 #include <XPLMScenery.h>
 #include <XPLMDataAccess.h>
 
-extern XPLMDataRef		gVisDataRef;		// Current air visiblity for culling.
-extern XPLMProbeRef		gTerrainProbe;
+#include "FrameContext.h"
+#include "TerrainCache.h"
+
+extern TerrainCache		gTerrainCache;		// Terrain heights for surface clamping.
 
 extern double	Render_FullPlaneDistance;
 
@@ -44,6 +46,12 @@ struct Label {
 };
 
 void	Renderer_Init();
+
+/** Render_PrepFrame runs the per-frame update of all the planes for the
+ * given frame.  Everything it needs to know about the sim comes from the
+ * context.  Normally called from the flight loop, via Render_PrepLists.
+ */
+void	Render_PrepFrame(const FrameContext &frame);
 void	Renderer_Attach_Callbacks();
 void	Renderer_Detach_Callbacks();
 
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+/** SmallVector is a minimal vector that keeps up to N elements inline,
+ * only going to the heap if it grows beyond that.
+ *
+ * It's only intended for small lists of plain values (handles, pointers and
+ * the like), so it's restricted to trivially copyable types and can't be
+ * copied.
+ */
+template <typename T, size_t N>
+class SmallVector {
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector only supports trivially copyable types");
+	static_assert(N > 0, "SmallVector needs some inline storage");
+public:
+	typedef T *			iterator;
+	typedef const T *	const_iterator;
+
+	SmallVector() :
+		mData(mInline),
+		mSize(0),
+		mCapacity(N)
+	{
+	}
+
+	~SmallVector()
+	{
+		if (mData != mInline) {
+			delete[] mData;
+		}
+	}
+
+	SmallVector(const SmallVector &) = delete;
+	SmallVector &operator=(const SmallVector &) = delete;
+
+	size_t size() const
+	{
+		return mSize;
+	}
+
+	bool empty() const
+	{
+		return mSize == 0;
+	}
+
+	T &operator[](size_t idx)
+	{
+		return mData[idx];
+	}
+
+	const T &operator[](size_t idx) const
+	{
+		return mData[idx];
+	}
+
+	iterator begin()
+	{
+		return mData;
+	}
+
+	iterator end()
+	{
+		return mData + mSize;
+	}
+
+	const_iterator begin() const
+	{
+		return mData;
+	}
+
+	const_iterator end() const
+	{
+		return mData + mSize;
+	}
+
+	void clear()
+	{
+		mSize = 0;
+	}
+
+	void reserve(size_t newCapacity)
+	{
+		if (newCapacity <= mCapacity) {
+			return;
+		}
+		T *newData = new T[newCapacity];
+		std::memcpy(newData, mData, mSize * sizeof(T));
+		if (mData != mInline) {
+			delete[] mData;
+		}
+		mData = newData;
+		mCapacity = newCapacity;
+	}
+
+	/** resize grows or shrinks the vector.  New elements are
+	 * value-initialised.
+	 */
+	void resize(size_t newSize)
+	{
+		if (newSize > mSize) {
+			if (newSize > mCapacity) {
+				reserve(std::max(newSize, mCapacity * 2));
+			}
+			std::fill(mData + mSize, mData + newSize, T());
+		}
+		mSize = newSize;
+	}
+
+	void push_back(const T &value)
+	{
+		if (mSize == mCapacity) {
+			reserve(mCapacity * 2);
+		}
+		mData[mSize++] = value;
+	}
+
+private:
+	T *		mData;
+	size_t	mSize;
+	size_t	mCapacity;
+	T		mInline[N];
+};
+
+#endif //SMALLVECTOR_H
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// keep the cell coordinates well clear of overflowing when rings are
+// stepped out from them.
+static const double cMaxCellCoord = 1 << 30;
+
+// looking up a cell (that's most likely empty) costs about as much as
+// going past this many occupied ones when going through them all.
+static const size_t cLookupsPerScan = 4;
+
+SpatialGrid::SpatialGrid() :
+	mCount(0)
+{
+}
+
+int32_t
+SpatialGrid::cellCoord(float v)
+{
+	if (!std::isfinite(v)) {
+		return 0;
+	}
+	const double coord = std::floor(static_cast<double>(v) / cCellSize);
+	return static_cast<int32_t>((std::max)(-cMaxCellCoord, (std::min)(cMaxCellCoord, coord)));
+}
+
+SpatialGrid::cellKey
+SpatialGrid::keyFor(int32_t cellX, int32_t cellZ)
+{
+	return (static_cast<cellKey>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellZ);
+}
+
+int32_t
+SpatialGrid::cellXOf(cellKey key)
+{
+	return static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+}
+
+int32_t
+SpatialGrid::cellZOf(cellKey key)
+{
+	return static_cast<int32_t>(static_cast<uint32_t>(key));
+}
+
+void
+SpatialGrid::clear()
+{
+	mCells.clear();
+	mLocation.clear();
+	mCount = 0;
+}
+
+void
+SpatialGrid::update(uint32_t item, float x, float y, float z)
+{
+	if (item >= mLocation.size()) {
+		mLocation.resize(item + 1, location{0, cNoSlot});
+	}
+	const cellKey key = keyFor(cellCoord(x), cellCoord(z));
+	auto &loc = mLocation[item];
+	if (loc.slot != cNoSlot) {
+		if (loc.key == key) {
+			// still in the same cell, so it's just the position to change.
+			auto &thisCell = mCells.find(key)->second;
+			thisCell.entries[loc.slot] = entry{item, x, y, z};
+			thisCell.minY = (std::min)(thisCell.minY, y);
+			thisCell.maxY = (std::max)(thisCell.maxY, y);
+			return;
+		}
+		removeFromCell(item);
+	}
+	auto &thisCell = mCells[key];
+	if (thisCell.entries.empty()) {
+		thisCell.minY = y;
+		thisCell.maxY = y;
+	} else {
+		thisCell.minY = (std::min)(thisCell.minY, y);
+		thisCell.maxY = (std::max)(thisCell.maxY, y);
+	}
+	loc.key = key;
+	loc.slot = static_cast<uint32_t>(thisCell.entries.size());
+	thisCell.entries.push_back(entry{item, x, y, z});
+	++mCount;
+}
+
+void
+SpatialGrid::removeFromCell(uint32_t item)
+{
+	auto &loc = mLocation[item];
+	auto cellIter = mCells.find(loc.key);
+	auto &entries = cellIter->second.entries;
+	if (loc.slot != entries.size() - 1) {
+		entries[loc.slot] = entries.back();
+		mLocation[entries[loc.slot].item].slot = loc.slot;
+	}
+	entries.pop_back();
+	if (entries.empty()) {
+		mCells.erase(cellIter);
+	}
+	loc.slot = cNoSlot;
+	--mCount;
+}
+
+void
+SpatialGrid::remove(uint32_t item)
+{
+	if (item < mLocation.size() && mLocation[item].slot != cNoSlot) {
+		removeFromCell(item);
+	}
+}
+
+void
+SpatialGrid::renumber(uint32_t from, uint32_t to)
+{
+	if (from >= mLocation.size() || from == to) {
+		return;
+	}
+	if (to >= mLocation.size()) {
+		mLocation.resize(to + 1, location{0, cNoSlot});
+	}
+	const location loc = mLocation[from];
+	mLocation[to] = loc;
+	mLocation[from].slot = cNoSlot;
+	if (loc.slot != cNoSlot) {
+		mCells.find(loc.key)->second.entries[loc.slot].item = to;
+	}
+}
+
+template <typename F>
+void
+SpatialGrid::forEachCell(int32_t minX, int32_t minZ, int32_t maxX, int32_t maxZ, F fn) const
+{
+	const uint64_t span = static_cast<uint64_t>(static_cast<int64_t>(maxX) - minX + 1) *
+		static_cast<uint64_t>(static_cast<int64_t>(maxZ) - minZ + 1);
+	if (span > mCells.size() / cLookupsPerScan) {
+		for (const auto &cellPair: mCells) {
+			const int32_t cellX = cellXOf(cellPair.first);
+			const int32_t cellZ = cellZOf(cellPair.first);
+			if (cellX >= minX && cellX <= maxX && cellZ >= minZ && cellZ <= maxZ) {
+				fn(cellPair.second);
+			}
+		}
+		return;
+	}
+	for (int32_t cellX = minX; cellX <= maxX; ++cellX) {
+		for (int32_t cellZ = minZ; cellZ <= maxZ; ++cellZ) {
+			auto cellIter = mCells.find(keyFor(cellX, cellZ));
+			if (cellIter != mCells.end()) {
+				fn(cellIter->second);
+			}
+		}
+	}
+}
+
+void
+SpatialGrid::queryRadius(float x, float y, float z, float radius, std::vector<uint32_t> &out) const
+{
+	if (mCount == 0 || !(radius >= 0.0f)) {
+		return;
+	}
+	const float radiusSqr = radius * radius;
+	forEachCell(cellCoord(x - radius), cellCoord(z - radius), cellCoord(x + radius), cellCoord(z + radius),
+		[&](const cell &thisCell) {
+			for (const auto &thisEntry: thisCell.entries) {
+				const float dx = thisEntry.x - x;
+				const float dy = thisEntry.y - y;
+				const float dz = thisEntry.z - z;
+				if (dx * dx + dy * dy + dz * dz <= radiusSqr) {
+					out.push_back(thisEntry.item);
+				}
+			}
+		});
+}
+
+void
+SpatialGrid::queryBox(const float boxMin[3], const float boxMax[3], std::vector<uint32_t> &out) const
+{
+	if (mCount == 0) {
+		return;
+	}
+	forEachCell(cellCoord(boxMin[0]), cellCoord(boxMin[2]), cellCoord(boxMax[0]), cellCoord(boxMax[2]),
+		[&](const cell &thisCell) {
+			if (thisCell.maxY < boxMin[1] || thisCell.minY > boxMax[1]) {
+				return;
+			}
+			for (const auto &thisEntry: thisCell.entries) {
+				if (thisEntry.x >= boxMin[0] && thisEntry.x <= boxMax[0] &&
+					thisEntry.y >= boxMin[1] && thisEntry.y <= boxMax[1] &&
+					thisEntry.z >= boxMin[2] && thisEntry.z <= boxMax[2]) {
+					out.push_back(thisEntry.item);
+				}
+			}
+		});
+}
+
+void
+SpatialGrid::queryNearest(float x, float y, float z, size_t k, std::vector<uint32_t> &out) const
+{
+	out.clear();
+	if (k == 0 || mCount == 0) {
+		return;
+	}
+
+	// the best found so far, as a max-heap on distance so the worst of them
+	// is the one to drop.
+	std::vector<std::pair<float, uint32_t>> best;
+	best.reserve((std::min)(k, mCount));
+	auto consider = [&](const cell &thisCell) {
+		for (const auto &thisEntry: thisCell.entries) {
+			const float dx = thisEntry.x - x;
+			const float dy = thisEntry.y - y;
+			const float dz = thisEntry.z - z;
+			const float distanceSqr = dx * dx + dy * dy + dz * dz;
+			if (best.size() < k) {
+				best.emplace_back(distanceSqr, thisEntry.item);
+				std::push_heap(best.begin(), best.end());
+			} else if (distanceSqr < best.front().first) {
+				std::pop_heap(best.begin(), best.end());
+				best.back() = std::make_pair(distanceSqr, thisEntry.item);
+				std::push_heap(best.begin(), best.end());
+			}
+		}
+	};
+
+	// work outwards a ring of cells at a time.  Everything beyond ring n is
+	// at least n cells' width away, so once we have k items nearer than
+	// that, we can stop.
+	const int64_t centreX = cellCoord(x);
+	const int64_t centreZ = cellCoord(z);
+	auto visit = [&](int64_t cellX, int64_t cellZ) {
+		auto cellIter = mCells.find(keyFor(static_cast<int32_t>(cellX), static_cast<int32_t>(cellZ)));
+		if (cellIter != mCells.end()) {
+			consider(cellIter->second);
+		}
+	};
+	for (int64_t ring = 0; ; ++ring) {
+		const uint64_t reachedCells = static_cast<uint64_t>((2 * ring + 1) * (2 * ring + 1));
+		if (reachedCells > mCells.size()) {
+			// the grid's sparse round here - it's cheaper to go through the
+			// rest of the occupied cells than to keep looking up empty ones.
+			for (const auto &cellPair: mCells) {
+				const int64_t offsetX = std::abs(cellXOf(cellPair.first) - centreX);
+				const int64_t offsetZ = std::abs(cellZOf(cellPair.first) - centreZ);
+				if ((std::max)(offsetX, offsetZ) >= ring) {
+					consider(cellPair.second);
+				}
+			}
+			break;
+		}
+		if (ring == 0) {
+			visit(centreX, centreZ);
+		} else {
+			for (int64_t offset = -ring; offset <= ring; ++offset) {
+				visit(centreX + offset, centreZ - ring);
+				visit(centreX + offset, centreZ + ring);
+			}
+			for (int64_t offset = -ring + 1; offset < ring; ++offset) {
+				visit(centreX - ring, centreZ + offset);
+				visit(centreX + ring, centreZ + offset);
+			}
+		}
+		if (best.size() == k) {
+			const float reach = static_cast<float>(ring) * cCellSize;
+			if (best.front().first <= reach * reach) {
+				break;
+			}
+		}
+	}
+
+	std::sort_heap(best.begin(), best.end());
+	out.reserve(best.size());
+	for (const auto &found: best) {
+		out.push_back(found.second);
+	}
+}
+
+bool
+SpatialGrid::cellMayBeVisible(cellKey key, const cell &thisCell, const CullInfo &camera,
+	float clipScale, float radius, float marginPerMeter)
+{
+	const float halfWidth = cCellSize * 0.5f;
+	const float centreX = (static_cast<float>(cellXOf(key)) + 0.5f) * cCellSize;
+	const float centreY = (thisCell.minY + thisCell.maxY) * 0.5f;
+	const float centreZ = (static_cast<float>(cellZOf(key)) + 0.5f) * cCellSize;
+	const float halfHeight = (thisCell.maxY - thisCell.minY) * 0.5f;
+	const float cellRadius = std::sqrt(2.0f * halfWidth * halfWidth + halfHeight * halfHeight);
+	// nothing in the cell is further away than its far side, so none of
+	// their margins can be any bigger than that.
+	const float farthest = std::sqrt(camera.SphereDistanceSqr(centreX, centreY, centreZ)) + cellRadius;
+	return camera.SphereIsVisible(centreX, centreY, centreZ,
+		cellRadius * clipScale + radius + farthest * marginPerMeter);
+}
+
+void
+SpatialGrid::queryFrustum(const CullInfo &camera, float radius, float marginPerMeter,
+	std::vector<uint32_t> &out) const
+{
+	const float clipScale = camera.ClipScale();
+	for (const auto &cellPair: mCells) {
+		if (!cellMayBeVisible(cellPair.first, cellPair.second, camera, clipScale, radius, marginPerMeter)) {
+			continue;
+		}
+		for (const auto &thisEntry: cellPair.second.entries) {
+			const float distance = std::sqrt(camera.SphereDistanceSqr(thisEntry.x, thisEntry.y, thisEntry.z));
+			if (camera.SphereIsVisible(thisEntry.x, thisEntry.y, thisEntry.z, radius + distance * marginPerMeter)) {
+				out.push_back(thisEntry.item);
+			}
+		}
+	}
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "CullInfo.h"
+
+/** SpatialGrid is a uniform grid over the local coordinates, for finding
+ * the planes near a point or within the camera's view without looking at
+ * every one.
+ *
+ * The grid is laid out over x and z only - each cell is a column from the
+ * ground up, so planes stacked over one another share a cell.  Only the
+ * occupied cells are held, keyed by their coordinates, and each keeps its
+ * items' positions so the queries don't need to look anything else up.
+ *
+ * Items are identified by a small integer (the PlaneRegistry's dense
+ * index), and are moved between cells as their positions are updated, so
+ * it's cheap to keep up to date a few planes at a time.  Sim thread only.
+ */
+class SpatialGrid {
+public:
+	// the width of a cell, in meters.
+	static constexpr float cCellSize = 10000.0f;
+
+	SpatialGrid();
+
+	/** clear removes everything from the grid. */
+	void clear();
+
+	/** update adds an item to the grid, or moves it if it's already there.
+	 *
+	 * @param item the item's index
+	 * @param x,y,z its position, in local coordinates
+	 */
+	void update(uint32_t item, float x, float y, float z);
+
+	/** remove takes an item out of the grid, if it's in it. */
+	void remove(uint32_t item);
+
+	/** renumber moves an item to a new index - for when the registry fills
+	 * a hole by moving its last plane into it.  Nothing must be held at the
+	 * new index.
+	 */
+	void renumber(uint32_t from, uint32_t to);
+
+	/** @return the number of items in the grid. */
+	size_t size() const
+	{
+		return mCount;
+	}
+
+	/** queryRadius finds the items within a given distance of a point.
+	 *
+	 * @param out the items found are appended to this, in no particular order
+	 */
+	void queryRadius(float x, float y, float z, float radius, std::vector<uint32_t> &out) const;
+
+	/** queryBox finds the items within an axis-aligned box.
+	 *
+	 * @param out the items found are appended to this, in no particular order
+	 */
+	void queryBox(const float boxMin[3], const float boxMax[3], std::vector<uint32_t> &out) const;
+
+	/** queryNearest finds the k items nearest to a point.
+	 *
+	 * @param out cleared, then filled with up to k items, nearest first
+	 */
+	void queryNearest(float x, float y, float z, size_t k, std::vector<uint32_t> &out) const;
+
+	/** queryFrustum finds the items that would be within the camera's view
+	 * if they were spheres of radius + distance * marginPerMeter.
+	 *
+	 * @param out the items found are appended to this, in no particular order
+	 */
+	void queryFrustum(const CullInfo &camera, float radius, float marginPerMeter,
+		std::vector<uint32_t> &out) const;
+
+private:
+	typedef uint64_t	cellKey;
+
+	struct entry {
+		uint32_t	item;
+		float		x;
+		float		y;
+		float		z;
+	};
+
+	// the heights only ever grow while the cell's occupied, so they're a
+	// bound, not the exact range.
+	struct cell {
+		std::vector<entry>	entries;
+		float				minY;
+		float				maxY;
+	};
+
+	struct location {
+		cellKey		key;
+		uint32_t	slot;		// index into the cell's entries, or cNoSlot if not in the grid
+	};
+
+	static const uint32_t		cNoSlot = UINT32_MAX;
+
+	static int32_t cellCoord(float v);
+	static cellKey keyFor(int32_t cellX, int32_t cellZ);
+	static int32_t cellXOf(cellKey key);
+	static int32_t cellZOf(cellKey key);
+
+	/** cellMayBeVisible tests a cell's bounds the way queryFrustum tests
+	 * its items, so nothing that would pass is in a cell that doesn't.
+	 */
+	static bool cellMayBeVisible(cellKey key, const cell &thisCell, const CullInfo &camera,
+		float clipScale, float radius, float marginPerMeter);
+
+	void removeFromCell(uint32_t item);
+
+	/** forEachCell calls fn(const cell &) for every occupied cell overlapping
+	 * the given range of cell coordinates - by looking each one up if the
+	 * range is small, or going through all of the occupied cells if not.
+	 */
+	template <typename F>
+	void forEachCell(int32_t minX, int32_t minZ, int32_t maxX, int32_t maxZ, F fn) const;
+
+	std::unordered_map<cellKey, cell>	mCells;
+	std::vector<location>				mLocation;		// indexed by item
+	size_t								mCount;
+};
+
+#endif //SPATIALGRID_H
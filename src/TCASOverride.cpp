@@ -91,17 +91,18 @@ TCAS::cleanFrame()
 	gTCASPlanes.clear();
 }
 
-void
+bool
 TCAS::addPlane(float distanceSqr, float x, float y, float z, float heading, const char *name, void *plane)
 {
 	if (!std::isnormal(distanceSqr) || !std::isnormal(x) || !std::isnormal(y) || !std::isnormal(z) || !std::isnormal(heading))
 	{
 		XPLMDebugString(name);
 		XPLMDebugString(": non-normal TCAS data\n");
-		return;
+		return false;
 	}
 	int mode_S = reinterpret_cast<std::uintptr_t>(plane) & 0xffffffu;
 	gTCASPlanes.push_back({ distanceSqr, x, y, z, heading, mode_S, name });
+	return true;
 }
 
 void
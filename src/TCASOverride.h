@@ -72,8 +72,17 @@ public:
 
 	static void cleanFrame();
 
-	/** adds a plane to the list of aircraft we're going to report on */
-	static void addPlane(float distanceSqr, float x, float y, float z, float heading, const char *name, void *plane);
+	/** @return the most aircraft we can report on */
+	static std::size_t capacity()
+	{
+		return gMaxTCASItems;
+	}
+
+	/** adds a plane to the list of aircraft we're going to report on
+	 *
+	 * @return false if the plane's position was unusable, and it was left out.
+	 */
+	static bool addPlane(float distanceSqr, float x, float y, float z, float heading, const char *name, void *plane);
 
 	/** forwards the list of aircraft to x-plane */
 	static void pushPlanes();
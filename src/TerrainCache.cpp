@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "TerrainCache.h"
+
+#include <cmath>
+
+TerrainCache::TerrainCache() :
+	mProbe(nullptr),
+	mSceneryLoading(false),
+	mOriginGeneration(0),
+	mGeneration(1),
+	mNow(0.0),
+	mBudget(cProbesPerFrame)
+{
+}
+
+void
+TerrainCache::init()
+{
+	if (mProbe == nullptr) {
+		mProbe = XPLMCreateProbe(xplm_ProbeY);
+	}
+}
+
+void
+TerrainCache::clear()
+{
+	mCells.clear();
+	++mGeneration;
+}
+
+void
+TerrainCache::beginFrame(const FrameContext &frame)
+{
+	mNow = frame.timestamp;
+	mBudget = cProbesPerFrame;
+
+	if (frame.originGeneration != mOriginGeneration) {
+		mOriginGeneration = frame.originGeneration;
+		clear();
+	}
+	// the terrain may have changed under us once a scenery load finishes.
+	if (mSceneryLoading && !frame.sceneryLoading) {
+		clear();
+	}
+	mSceneryLoading = frame.sceneryLoading;
+
+	if (mCells.size() > cPruneSize) {
+		for (auto iter = mCells.begin(); iter != mCells.end();) {
+			if (mNow - iter->second.probedAt > cTimeToLive) {
+				iter = mCells.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+	}
+}
+
+TerrainCache::Result
+TerrainCache::heightAt(double x, double y, double z, double &outY)
+{
+	const auto cellX = static_cast<int32_t>(std::floor(x / cCellSize));
+	const auto cellZ = static_cast<int32_t>(std::floor(z / cCellSize));
+	const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellZ);
+
+	auto iter = mCells.find(key);
+	const bool expired = (iter == mCells.end()) || (mNow - iter->second.probedAt > cTimeToLive);
+	if (expired && mBudget > 0 && mProbe != nullptr) {
+		--mBudget;
+		XPLMProbeInfo_t	probeResult = {};
+		probeResult.structSize = sizeof(XPLMProbeInfo_t);
+		const XPLMProbeResult r = XPLMProbeTerrainXYZ(mProbe,
+			static_cast<float>((cellX + 0.5) * cCellSize), static_cast<float>(y), static_cast<float>((cellZ + 0.5) * cCellSize),
+			&probeResult);
+		iter = mCells.emplace(key, cell{}).first;
+		iter->second.y = probeResult.locationY;
+		iter->second.probedAt = mNow;
+		iter->second.hit = (r == xplm_ProbeHitTerrain);
+	}
+	if (iter == mCells.end()) {
+		return Result::OverBudget;
+	}
+	if (!iter->second.hit) {
+		return Result::NotFound;
+	}
+	outY = iter->second.y;
+	return Result::Found;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef TERRAINCACHE_H
+#define TERRAINCACHE_H
+
+#include <cstdint>
+#include <unordered_map>
+
+#include <XPLMScenery.h>
+
+#include "FrameContext.h"
+
+/** TerrainCache remembers the height of the terrain for surface clamping,
+ * so planes don't each need an XPLMProbeTerrainXYZ every frame.
+ *
+ * Heights are kept per cell of a cCellSize grid in local coordinates,
+ * probed at the middle of the cell, and re-probed once they're older than
+ * cTimeToLive.  The whole cache is dropped whenever the sim shifts its local
+ * coordinate system or finishes loading scenery - generation() changes when
+ * it is, so anything holding on to heights from it can tell they're stale.
+ *
+ * No more than cProbesPerFrame probes are made each frame.  Beyond that,
+ * expired heights are returned as they are, and anything not in the cache
+ * at all has to wait for a later frame.
+ *
+ * Sim thread only.
+ */
+class TerrainCache {
+public:
+	// the size (in meters) of the grid cells.
+	static constexpr double cCellSize = 10.0;
+
+	// how long (in seconds) a probed height is good for.
+	static constexpr double cTimeToLive = 30.0;
+
+	// the most probes we'll make in a frame.
+	static constexpr int cProbesPerFrame = 100;
+
+	// planes more than this far (in meters) above the terrain last found
+	// under them, plus cMaxSlope times how far they've gone since, can't
+	// possibly be below the surface, and needn't be clamped at all.
+	static constexpr double cClearance = 300.0;
+	static constexpr double cMaxSlope = 1.0;
+
+	enum class Result {
+		Found,			// there's terrain, and outY is set
+		NotFound,		// there's no terrain there
+		OverBudget,		// we don't know yet - try again next frame
+	};
+
+	TerrainCache();
+
+	/** init creates the probe. */
+	void init();
+
+	/** beginFrame resets the probe budget, and drops the cache if the local
+	 * coordinate system has changed or the sim has just loaded scenery.
+	 */
+	void beginFrame(const FrameContext &frame);
+
+	/** heightAt finds the height of the terrain under a point.
+	 *
+	 * @param x
+	 * @param y
+	 * @param z the point in local coordinates
+	 * @param outY set to the local y coordinate of the terrain, if found
+	 */
+	Result heightAt(double x, double y, double z, double &outY);
+
+	/** generation changes every time the cache is dropped. */
+	uint32_t generation() const
+	{
+		return mGeneration;
+	}
+
+private:
+	// cells that grow beyond this many are pruned of expired heights.
+	static const size_t cPruneSize = 65536;
+
+	struct cell {
+		double	y;
+		double	probedAt;
+		bool	hit;
+	};
+
+	void clear();
+
+	std::unordered_map<uint64_t, cell>	mCells;
+	XPLMProbeRef	mProbe;
+	bool			mSceneryLoading;
+	uint32_t		mOriginGeneration;
+	uint32_t		mGeneration;
+	double			mNow;
+	int				mBudget;
+};
+
+#endif //TERRAINCACHE_H
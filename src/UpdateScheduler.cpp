@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "UpdateScheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
+
+UpdateScheduler::UpdateScheduler() :
+	mCycle(0),
+	mInterval{1, 1, 1, 1},
+	mNearDistanceSqr(0.0f),
+	mFarDistanceSqr(0.0f)
+{
+}
+
+void
+UpdateScheduler::beginFrame(const FrameContext &frame, const PlaneRegistry &planes)
+{
+	mCycle = static_cast<unsigned>(frame.cycle);
+	mInterval[Near] = 1;
+	mInterval[Mid] = static_cast<unsigned>(std::max(gConfiguration.midTierUpdateInterval, 1));
+	mInterval[Far] = static_cast<unsigned>(std::max(gConfiguration.farTierUpdateInterval, 1));
+	mInterval[Offscreen] = static_cast<unsigned>(std::max(gConfiguration.offscreenUpdateInterval, 1));
+
+	// a plane of radius r at distance d covers r * scale / d of the screen's
+	// height, so zooming in brings the near tier out.
+	float nearDistance = gConfiguration.nearTierDistance * 1000.0f;
+	if (gConfiguration.nearTierScreenSize > 0.0f) {
+		nearDistance = std::max(nearDistance,
+			cPlaneRadius * frame.cullInfo.ScreenScale() / gConfiguration.nearTierScreenSize);
+	}
+	const float farDistance = std::max(gConfiguration.farTierDistance * 1000.0f, nearDistance);
+	mNearDistanceSqr = nearDistance * nearDistance;
+	mFarDistanceSqr = farDistance * farDistance;
+
+	// sort the planes by tier, and then by whether they're owed an update,
+	// keeping them in order otherwise.
+	const size_t count = planes.size();
+	mTier.resize(count);
+	mOrder.resize(count);
+	mBucket.resize(count);
+	size_t bucketCount[TierCount * 2] = {};
+	for (size_t idx = 0; idx < count; ++idx) {
+		const Tier tier = tierFor(planes.distanceSqrAt(idx), planes.inViewAt(idx));
+		const bool owed = planes.at(idx).isUpdateOwed();
+		mTier[idx] = static_cast<uint8_t>(tier);
+		mBucket[idx] = static_cast<uint8_t>(tier * 2 + (owed ? 0 : 1));
+		++bucketCount[mBucket[idx]];
+	}
+	size_t next[TierCount * 2];
+	size_t start = 0;
+	for (int bucket = 0; bucket < TierCount * 2; ++bucket) {
+		next[bucket] = start;
+		start += bucketCount[bucket];
+	}
+	for (size_t idx = 0; idx < count; ++idx) {
+		mOrder[next[mBucket[idx]]++] = static_cast<uint32_t>(idx);
+	}
+}
+
+UpdateMode
+UpdateScheduler::modeFor(XPMPPlaneID id, Tier tier) const
+{
+	const unsigned interval = mInterval[tier];
+	const auto phase = static_cast<unsigned>(reinterpret_cast<uintptr_t>(id) % interval);
+	if ((mCycle % interval) == phase) {
+		return UpdateMode::Full;
+	}
+	return (tier == Offscreen) ? UpdateMode::Defer : UpdateMode::Move;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef UPDATESCHEDULER_H
+#define UPDATESCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "XPMPMultiplayer.h"
+#include "FrameContext.h"
+
+class PlaneRegistry;
+
+/** how much of a plane's per-frame update to do. */
+enum class UpdateMode {
+	Full,		// position, clamp, level of detail and animation
+	Move,		// just move the instance, leaving everything else as it was
+	Defer,		// leave the instance where it is
+};
+
+/** UpdateScheduler decides how often each plane gets a full update.
+ *
+ * Planes are put into tiers by how far away they are and how big they'd be
+ * on the screen:
+ *
+ * - Near planes (in view, and either within nearTierDistance or at least
+ *   nearTierScreenSize tall) are fully updated every frame.
+ * - Mid planes (in view, out to farTierDistance) are fully updated once
+ *   every midTierUpdateInterval frames.
+ * - Far planes (in view, beyond that) are fully updated once every
+ *   farTierUpdateInterval frames.
+ * - Offscreen planes are fully updated once every offscreenUpdateInterval
+ *   frames.
+ *
+ * Each plane's turn comes round on a frame set by its ID, so each frame
+ * fully updates an even slice of each tier.  In between, mid and far planes
+ * are still moved to where they are now, so they keep moving smoothly -
+ * it's the terrain, level of detail and animation that's left as it was.
+ * Offscreen planes are left where they are.
+ *
+ * The planes are updated a tier at a time, nearest first, so if the frame
+ * runs out of its FrameBudget, it's the further planes' updates that are
+ * put off.  Within each tier, the planes with work put off from earlier
+ * frames go first, so everything gets its turn.
+ */
+class UpdateScheduler {
+public:
+	enum Tier {
+		Near,
+		Mid,
+		Far,
+		Offscreen,
+		TierCount
+	};
+
+	// the size (in meters, from the middle) of a typical plane, for working
+	// out how big it'll be on the screen.
+	static constexpr float cPlaneRadius = 20.0f;
+
+	UpdateScheduler();
+
+	/** beginFrame picks up the configuration and the camera for the frame,
+	 * and works out the planes' tiers and the order to update them in.  The
+	 * planes' distances and visibility must already have been brought up to
+	 * date by PlaneRegistry::updateInView.
+	 */
+	void beginFrame(const FrameContext &frame, const PlaneRegistry &planes);
+
+	/** @return the indices of the planes, a tier at a time, nearest first,
+	 *     and those with work owed first within each tier.
+	 */
+	const std::vector<uint32_t> &order() const
+	{
+		return mOrder;
+	}
+
+	/** @return the tier the plane at the given index is in this frame. */
+	Tier tierAt(size_t idx) const
+	{
+		return static_cast<Tier>(mTier[idx]);
+	}
+
+	/** tierFor works out which tier a plane is in.
+	 *
+	 * @param distanceSqr the square of the plane's distance from the camera
+	 * @param inView true if the plane is within the camera's view
+	 */
+	Tier tierFor(float distanceSqr, bool inView) const
+	{
+		if (!inView) {
+			return Offscreen;
+		}
+		if (distanceSqr <= mNearDistanceSqr) {
+			return Near;
+		}
+		return (distanceSqr <= mFarDistanceSqr) ? Mid : Far;
+	}
+
+	/** modeFor works out how much of a plane's update to do this frame. */
+	UpdateMode modeFor(XPMPPlaneID id, Tier tier) const;
+
+private:
+	unsigned	mCycle;
+	unsigned	mInterval[TierCount];
+	float		mNearDistanceSqr;
+	float		mFarDistanceSqr;
+
+	// per-plane tiers, and scratch for sorting the planes into mOrder.
+	std::vector<uint8_t>	mTier;
+	std::vector<uint8_t>	mBucket;
+	std::vector<uint32_t>	mOrder;
+};
+
+#endif //UPDATESCHEDULER_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+std::unique_ptr<WorkerPool>		WorkerPool::sShared;
+
+WorkerPool::WorkerPool(unsigned threadCount) :
+	mStopping(false)
+{
+	threadCount = max(1u, threadCount);
+	mThreads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i) {
+		mThreads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(mLock);
+		mStopping = true;
+		mJobs.clear();
+	}
+	mWake.notify_all();
+	for (auto &thread: mThreads) {
+		thread.join();
+	}
+}
+
+void
+WorkerPool::submit(std::function<void()> job)
+{
+	{
+		lock_guard<mutex> lock(mLock);
+		mJobs.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+void
+WorkerPool::rangeJob::work()
+{
+	for (;;) {
+		const size_t chunk = next.fetch_add(1);
+		if (chunk >= chunks) {
+			return;
+		}
+		const size_t begin = chunk * grain;
+		fn(begin, min(begin + grain, count));
+		if (done.fetch_add(1) + 1 == chunks) {
+			lock_guard<mutex> doneLock(lock);
+			finished.notify_all();
+		}
+	}
+}
+
+void
+WorkerPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn)
+{
+	if (count == 0) {
+		return;
+	}
+	grain = max<size_t>(1, grain);
+	const size_t chunks = (count + grain - 1) / grain;
+	if (chunks == 1) {
+		fn(0, count);
+		return;
+	}
+
+	// helpers may not get to run until after we're done, so the job has to
+	// outlive this call.
+	auto job = make_shared<rangeJob>();
+	job->fn = fn;
+	job->count = count;
+	job->grain = grain;
+	job->chunks = chunks;
+	job->next = 0;
+	job->done = 0;
+
+	const size_t helpers = min<size_t>(size(), chunks - 1);
+	for (size_t i = 0; i < helpers; ++i) {
+		submit([job] { job->work(); });
+	}
+	job->work();
+
+	unique_lock<mutex> doneLock(job->lock);
+	job->finished.wait(doneLock, [&job] { return job->done.load() == job->chunks; });
+}
+
+void
+WorkerPool::run()
+{
+	for (;;) {
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(mLock);
+			mWake.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+			if (mStopping) {
+				return;
+			}
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+		job();
+	}
+}
+
+WorkerPool &
+WorkerPool::get()
+{
+	if (!sShared) {
+		// leave a core for the sim, and don't go overboard on big machines -
+		// none of our work is big enough to make use of them.
+		unsigned cores = thread::hardware_concurrency();
+		unsigned threads = (cores > 1) ? min(cores - 1, 4u) : 1u;
+		sShared.reset(new WorkerPool(threads));
+	}
+	return *sShared;
+}
+
+void
+WorkerPool::shutdown()
+{
+	sShared.reset();
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** WorkerPool is a small, fixed-size pool of threads for jobs that don't
+ * need to touch the XPLM.
+ *
+ * Nothing submitted to the pool may call into X-Plane - the XPLM may only be
+ * used from the sim thread.
+ */
+class WorkerPool {
+public:
+	explicit WorkerPool(unsigned threadCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/** queue a job to be run on one of the worker threads. */
+	void submit(std::function<void()> job);
+
+	/** parallelFor runs fn over the range [0,count), split into chunks of
+	 * grain items, on the worker threads and the calling thread, and returns
+	 * once they've all been done.
+	 *
+	 * The calling thread takes chunks too, so this never waits for the
+	 * workers to finish jobs submitted earlier - at worst, it does all the
+	 * work itself.
+	 *
+	 * @param count the number of items
+	 * @param grain the number of items in each chunk
+	 * @param fn called as fn(begin, end) for each chunk
+	 */
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+	unsigned size() const
+	{
+		return static_cast<unsigned>(mThreads.size());
+	}
+
+	/** get returns the shared pool, starting it if necessary. */
+	static WorkerPool &get();
+
+	/** shutdown stops the shared pool (if running), waiting for the workers
+	 * to finish their current jobs.  Jobs that haven't started are discarded.
+	 */
+	static void shutdown();
+
+private:
+	// shared between the caller and the workers for a single parallelFor.
+	struct rangeJob {
+		std::function<void(size_t, size_t)>	fn;
+		size_t								count;
+		size_t								grain;
+		size_t								chunks;
+		std::atomic<size_t>					next;
+		std::atomic<size_t>					done;
+		std::mutex							lock;
+		std::condition_variable				finished;
+
+		// run chunks until there are none left.
+		void work();
+	};
+
+	void run();
+
+	std::vector<std::thread>			mThreads;
+	std::deque<std::function<void()>>	mJobs;
+	std::mutex							mLock;
+	std::condition_variable				mWake;
+	bool								mStopping;
+
+	static std::unique_ptr<WorkerPool>	sShared;
+};
+
+#endif //WORKERPOOL_H
@@ -21,12 +21,17 @@
  *
  */
 
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
 #include <cstdlib>
 #include <cstdio>
 #include <set>
 #include <cassert>
 #include <algorithm>
 #include <cctype>
+#include <limits>
 #include <vector>
 #include <string>
 #include <cstring>
@@ -35,31 +40,37 @@
 
 #include <XPLMUtilities.h>
 #include <XPLMPlanes.h>
+#include <XPLMGraphics.h>
 #include <XPMPMultiplayer.h>
 #include "PlanesHandoff.h"
 
 #include "XPMPMultiplayer.h"
 #include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
+#include "PlaneCommands.h"
+#include "PlaneSnapshot.h"
 #include "TCASOverride.h"
 #include "CSLLibrary.h"
 #include "XUtils.h"
 #include "Renderer.h"
+#include "MatchTrace.h"
+#include "RematchSweep.h"
+#include "WorkerPool.h"
+#include "LODController.h"
 #include "obj8/Obj8CSL.h"
 
 
 // This prints debug info on our process of loading Austin's planes.
 #define    DEBUG_MANUAL_LOADING    0
 
+/** XPMPPlaneFromID resolves a plane handle.
+ *
+ * @return the plane, or nullptr if the handle is stale or invalid.
+ */
 static XPMPPlanePtr
-XPMPPlaneFromID(XPMPPlaneID inID, XPMPPlaneMap::iterator *outIter = nullptr)
+XPMPPlaneFromID(XPMPPlaneID inID)
 {
-    assert(inID);
-    auto planeIter = gPlanes.find(inID);
-    assert(planeIter != gPlanes.end());
-    if (outIter) {
-        *outIter = planeIter;
-    }
-    return static_cast<XPMPPlanePtr>(inID);
+    return gPlanes.find(inID);
 }
 
 /********************************************************************************
@@ -74,6 +85,7 @@ XPMPMultiplayerInit(XPMPConfiguration_t *inConfiguration,
     if (nullptr != inConfiguration) {
         memcpy(&gConfiguration, inConfiguration, sizeof(gConfiguration));
     }
+    PlaneCommands::setSimThread();
 
     // set up OBJ8 support
     Obj8CSL::Init();
@@ -93,6 +105,8 @@ void
 XPMPSetConfiguration(XPMPConfiguration_t *inConfig)
 {
     memcpy(&gConfiguration, inConfig, sizeof(gConfiguration));
+    // clamping and detail distances may have changed.
+    gPlanes.markAllDirty();
 }
 
 void
@@ -114,6 +128,9 @@ void
 XPMPMultiplayerCleanup()
 {
     Renderer_Detach_Callbacks();
+    PlaneCommands::stop();
+    RematchSweep::cancel();
+    WorkerPool::shutdown();
 }
 
 static void MPPlanesAcquired(void * /*refcon*/)
@@ -132,6 +149,7 @@ XPMPMultiplayerEnable()
     Planes_SafeAcquire(&MPPlanesAcquired, &MPPlanesReleased, nullptr, 0);
     // put in the rendering hook now
     Renderer_Attach_Callbacks();
+    PlaneCommands::start();
     return "";
 }
 
@@ -140,7 +158,10 @@ XPMPMultiplayerDisable(void)
 {
     Renderer_Detach_Callbacks();
     Planes_SafeRelease();
+    // nothing will drain the queue until we're enabled again.
+    PlaneCommands::stop();
     gPlanes.clear();
+    PlaneSnapshot::publish();
 }
 
 const char *
@@ -159,11 +180,7 @@ XPMPLoadCSLPackages(const char *inCSLFolder)
 int
 XPMPGetNumberOfInstalledModels(void)
 {
-    size_t number = 0;
-    for (const auto &package : gPackages) {
-        number += package.planes.size();
-    }
-    return static_cast<int>(number);
+    return static_cast<int>(gCatalog.models.size());
 }
 
 void
@@ -173,46 +190,86 @@ XPMPGetModelInfo(int inIndex,
                  const char **outAirline,
                  const char **outLivery)
 {
-    int counter = 0;
-    for (const auto &package : gPackages) {
-        if (counter + static_cast<int>(package.planes.size()) < inIndex + 1) {
-            counter += static_cast<int>(package.planes.size());
-            continue;
-        }
+    if (inIndex < 0 || inIndex >= static_cast<int>(gCatalog.models.size())) {
+        return;
+    }
+    const CSL *csl = gCatalog.models[inIndex];
+    if (outModelName) {
+        *outModelName = csl->getModelName().c_str();
+    }
+    if (outIcao) {
+        *outIcao = csl->getICAO().c_str();
+    }
+    if (outAirline) {
+        *outAirline = csl->getAirline().c_str();
+    }
+    if (outLivery) {
+        *outLivery = csl->getLivery().c_str();
+    }
+}
 
-        int positionInPackage = inIndex - counter;
-        if (outModelName) {
-            *outModelName = package.planes[positionInPackage]->getModelName().c_str();
-        }
-        if (outIcao) {
-            *outIcao = package.planes[positionInPackage]->getICAO().c_str();
-        }
-        if (outAirline) {
-            *outAirline = package.planes[positionInPackage]->getAirline().c_str();
-        }
-        if (outLivery) {
-            *outLivery = package.planes[positionInPackage]->getLivery().c_str();
-        }
-        break;
+int
+XPMPFindModels(const char *inICAOPrefix,
+               const char *inAirlinePrefix,
+               int *outIndices,
+               int inMaxIndices)
+{
+    std::vector<int> found;
+    CSL_FindModels(inICAOPrefix ? inICAOPrefix : "",
+                   inAirlinePrefix ? inAirlinePrefix : "",
+                   found);
+
+    if (outIndices != nullptr && inMaxIndices > 0) {
+        const auto toCopy = std::min(found.size(), static_cast<size_t>(inMaxIndices));
+        std::copy(found.begin(), found.begin() + toCopy, outIndices);
     }
+    return static_cast<int>(found.size());
 }
 
 /********************************************************************************
  * PLANE OBJECT SUPPORT
  ********************************************************************************/
 
+/** CreatePlane creates a plane, or if called off the sim thread, reserves
+ * an ID for it and queues its creation.
+ */
+static XPMPPlaneID
+CreatePlane(
+    const char *inModelName,
+    const char *inICAOCode,
+    const char *inAirline,
+    const char *inLivery)
+{
+    if (PlaneCommands::onSimThread()) {
+        XPMPPlane &plane = gPlanes.create();
+        InitPlane(plane, inICAOCode, inAirline, inLivery, inModelName);
+        return plane.getID();
+    }
+
+    PlaneCommands::command cmd;
+    cmd.kind = PlaneCommands::command::type::Create;
+    // read before reserving, so a clear in between cancels the creation.
+    cmd.epoch = gPlanes.epoch();
+    cmd.plane = gPlanes.reserve();
+    if (cmd.plane == nullptr) {
+        return nullptr;
+    }
+    cmd.icao = inICAOCode ? inICAOCode : "";
+    cmd.airline = inAirline ? inAirline : "";
+    cmd.livery = inLivery ? inLivery : "";
+    cmd.modelName = inModelName ? inModelName : "";
+    const XPMPPlaneID id = cmd.plane;
+    PlaneCommands::post(std::move(cmd));
+    return id;
+}
+
 XPMPPlaneID
 XPMPCreatePlane(
     const char *inICAOCode,
     const char *inAirline,
     const char *inLivery)
 {
-    auto plane = std::make_unique<XPMPPlane>();
-    plane->setType(PlaneType(inICAOCode, inAirline, inLivery));
-    plane->updateCSL();
-    XPMPPlanePtr planePtr = plane.get();
-    gPlanes.emplace(planePtr, std::move(plane));
-    return planePtr;
+    return CreatePlane(nullptr, inICAOCode, inAirline, inLivery);
 }
 
 XPMPPlaneID
@@ -222,44 +279,22 @@ XPMPCreatePlaneWithModelName(
     const char *inAirline,
     const char *inLivery)
 {
-    auto plane = std::make_unique<XPMPPlane>();
-    plane->setType(PlaneType(inICAOCode, inAirline, inLivery));
-
-    // Find the model
-    bool found = false;
-    for (const auto &package : gPackages) {
-        auto cslPlane = std::find_if(package.planes.begin(),
-                                     package.planes.end(),
-                                     [inModelName](CSL *p) {
-                                         return p->getModelName() ==
-                                                inModelName;
-                                     });
-        if (cslPlane != package.planes.end()) {
-            plane->setCSL(*cslPlane);
-            found = true;
-        }
-    }
-
-    if (!found) {
-        XPLMDebugString("Requested model ");
-        XPLMDebugString(inModelName);
-        XPLMDebugString(" is unknown! Falling back to own model matching.");
-        XPLMDebugString("\n");
-        plane->updateCSL();
-    }
-
-    XPMPPlanePtr planePtr = plane.get();
-    gPlanes.emplace(planePtr, std::move(plane));
-    return planePtr;
+    return CreatePlane(inModelName, inICAOCode, inAirline, inLivery);
 }
 
 void
 XPMPDestroyPlane(XPMPPlaneID inID)
 {
-    XPMPPlaneMap::iterator iter;
-    XPMPPlaneFromID(inID, &iter);
-
-    gPlanes.erase(iter);
+    if (!PlaneCommands::onSimThread()) {
+        PlaneCommands::command cmd;
+        cmd.kind = PlaneCommands::command::type::Destroy;
+        cmd.plane = inID;
+        PlaneCommands::post(std::move(cmd));
+        return;
+    }
+    if (!gPlanes.destroy(inID)) {
+        XPLMDump() << XPMP_CLIENT_NAME " WARNING: XPMPDestroyPlane called with an invalid or stale plane ID\n";
+    }
 }
 
 int
@@ -273,6 +308,9 @@ XPMPChangePlaneModel(
     PlaneType newType(inICAOCode, inAirline, inLivery);
 
     XPMPPlanePtr plane = XPMPPlaneFromID(inPlaneID);
+    if (plane == nullptr) {
+        return -1;
+    }
     if (force_change) {
         plane->setType(newType);
         plane->updateCSL();
@@ -288,6 +326,8 @@ void
 XPMPSetDefaultPlaneICAO(
     const char *inICAO)
 {
+    // the sweep's workers read the default plane whilst matching.
+    RematchSweep::defaultChanged();
     gDefaultPlane.mICAO = inICAO;
 }
 
@@ -297,6 +337,133 @@ XPMPCountPlanes(void)
     return static_cast<long>(gPlanes.size());
 }
 
+size_t
+XPMPGetPlaneSnapshot(
+    XPMPPlaneSnapshot_t *outPlanes,
+    size_t inSnapshotSize,
+    size_t inMaxPlanes,
+    double *outTimestamp)
+{
+    if (outPlanes == nullptr) {
+        inMaxPlanes = 0;
+    }
+    return PlaneSnapshot::copy(outPlanes, inSnapshotSize, inMaxPlanes, outTimestamp);
+}
+
+// how much further than asked the radius query searches the grid (meters).
+static const float cQueryRadiusSlack = 1.0f;
+
+// scratch for the plane queries.
+static std::vector<uint32_t> gQueryFound;
+static std::vector<XPMPPlaneDistance_t> gQueryResults;
+
+/** QueryLocal converts a query's position into local coordinates. */
+static void
+QueryLocal(double inLat, double inLon, double inElevation, double outLocal[3])
+{
+    XPLMWorldToLocal(inLat, inLon, inElevation * kFtToMeters, &outLocal[0], &outLocal[1], &outLocal[2]);
+}
+
+/** CopyQueryResults works out the distances to the planes found by a query,
+ * and copies the nearest inMaxPlanes of them out, nearest first.
+ *
+ * @param inMaxDistance planes further away than this are left out.  This is
+ *     checked against the distance as reported, so it's exact.
+ * @return the number of planes found.
+ */
+static size_t
+CopyQueryResults(const double local[3], float inMaxDistance, XPMPPlaneDistance_t *outPlanes,
+                 size_t inResultSize, size_t inMaxPlanes)
+{
+    gQueryResults.clear();
+    for (const auto idx: gQueryFound) {
+        double planeLocal[3];
+        gPlanes.localAt(idx, planeLocal);
+        const double dx = planeLocal[0] - local[0];
+        const double dy = planeLocal[1] - local[1];
+        const double dz = planeLocal[2] - local[2];
+        const auto distance = static_cast<float>(std::sqrt(dx * dx + dy * dy + dz * dz));
+        if (distance > inMaxDistance) {
+            continue;
+        }
+        gQueryResults.push_back(XPMPPlaneDistance_t{gPlanes.at(idx).getID(), distance});
+    }
+    const size_t found = gQueryResults.size();
+    const size_t copied = std::min(found, inMaxPlanes);
+    // the grid's ordering is only as good as its float positions, so sort
+    // on the distances worked out here even when it's nearest first already.
+    auto nearer = [](const XPMPPlaneDistance_t &a, const XPMPPlaneDistance_t &b) {
+        return a.distance < b.distance;
+    };
+    const auto copiedEnd = gQueryResults.begin() + static_cast<ptrdiff_t>(copied);
+    if (copied < found) {
+        std::nth_element(gQueryResults.begin(), copiedEnd, gQueryResults.end(), nearer);
+    }
+    std::sort(gQueryResults.begin(), copiedEnd, nearer);
+    auto *out = reinterpret_cast<uint8_t *>(outPlanes);
+    for (size_t n = 0; n < copied; ++n) {
+        memcpy(out + n * inResultSize, &gQueryResults[n], std::min(inResultSize, sizeof(XPMPPlaneDistance_t)));
+    }
+    return found;
+}
+
+size_t
+XPMPQueryPlanesInRadius(
+    double inLat,
+    double inLon,
+    double inElevation,
+    float inRadius,
+    XPMPPlaneDistance_t *outPlanes,
+    size_t inResultSize,
+    size_t inMaxPlanes)
+{
+    // the index is rebuilt as the sim thread moves planes, so it can't be
+    // read from anywhere else.
+    if (!PlaneCommands::onSimThread()) {
+        return 0;
+    }
+    if (outPlanes == nullptr) {
+        inMaxPlanes = 0;
+    }
+    double local[3];
+    QueryLocal(inLat, inLon, inElevation, local);
+    // the grid only has the planes' positions as floats, which are a few
+    // centimetres out hundreds of kilometres from the origin, so search a
+    // little further and then check the distances properly.
+    gQueryFound.clear();
+    gPlanes.grid().queryRadius(static_cast<float>(local[0]), static_cast<float>(local[1]),
+                               static_cast<float>(local[2]), inRadius + cQueryRadiusSlack, gQueryFound);
+    return CopyQueryResults(local, inRadius, outPlanes, inResultSize, inMaxPlanes);
+}
+
+size_t
+XPMPQueryNearestPlanes(
+    double inLat,
+    double inLon,
+    double inElevation,
+    XPMPPlaneDistance_t *outPlanes,
+    size_t inResultSize,
+    size_t inMaxPlanes)
+{
+    if (!PlaneCommands::onSimThread() || outPlanes == nullptr) {
+        return 0;
+    }
+    double local[3];
+    QueryLocal(inLat, inLon, inElevation, local);
+    gPlanes.grid().queryNearest(static_cast<float>(local[0]), static_cast<float>(local[1]),
+                                static_cast<float>(local[2]), inMaxPlanes, gQueryFound);
+    return CopyQueryResults(local, std::numeric_limits<float>::infinity(), outPlanes, inResultSize,
+                            inMaxPlanes);
+}
+
+double
+XPMPGetTimestamp(void)
+{
+    using seconds = std::chrono::duration<double>;
+    return std::chrono::duration_cast<seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 bool
 XPMPIsICAOValid(
     const char *inICAO)
@@ -309,7 +476,9 @@ XPMPGetPlaneModelQuality(
     XPMPPlaneID inPlane)
 {
     XPMPPlanePtr thisPlane = XPMPPlaneFromID(inPlane);
-
+    if (thisPlane == nullptr) {
+        return -1;
+    }
     return thisPlane->getMatchQuality();
 }
 
@@ -333,6 +502,66 @@ XPMPDumpOneCycle(void)
     CSL_Dump();
 }
 
+void
+XPMPGetLODStatus(XPMPLODStatus_t *outStatus)
+{
+    if (outStatus == nullptr) {
+        return;
+    }
+    XPMPLODStatus_t status = {};
+    status.size = outStatus->size;
+    status.framePeriod = gLODController.framePeriod();
+    status.prepTime = gLODController.prepTime();
+    status.detailScale = gLODController.detailScale();
+    status.rangeScale = gLODController.rangeScale();
+    status.countScale = gLODController.countScale();
+    memcpy(outStatus, &status, std::min(outStatus->size, sizeof(status)));
+}
+
+/** QueueUpdates copies a set of updates made off the sim thread into a
+ * command to be applied at the start of the next frame.
+ */
+static void
+QueueUpdates(uint8_t *ptr, size_t inUpdateSize, size_t inCount)
+{
+    // our default structure is 4 pointers long.
+    if (inUpdateSize < (sizeof(void *) * 4)) {
+        return;
+    }
+
+    PlaneCommands::command cmd;
+    cmd.kind = PlaneCommands::command::type::Update;
+    cmd.updates.reserve(inCount);
+    for (size_t idx = 0; idx < inCount; idx++) {
+        auto *thisUpdate = reinterpret_cast<XPMPUpdate_t *>(ptr + (idx * inUpdateSize));
+        if (thisUpdate->plane == nullptr) {
+            continue;
+        }
+
+        PlaneCommands::update queued = {};
+        queued.plane = thisUpdate->plane;
+        if (thisUpdate->position) {
+            queued.hasPosition = true;
+            memcpy(&queued.position, thisUpdate->position,
+                   std::min(thisUpdate->position->size, sizeof(queued.position)));
+        }
+        if (thisUpdate->surfaces) {
+            queued.hasSurfaces = true;
+            memcpy(&queued.surfaces, thisUpdate->surfaces,
+                   std::min(thisUpdate->surfaces->size, sizeof(queued.surfaces)));
+        }
+        if (thisUpdate->surveillance) {
+            queued.hasSurveillance = true;
+            memcpy(&queued.surveillance, thisUpdate->surveillance,
+                   std::min(thisUpdate->surveillance->size, sizeof(queued.surveillance)));
+        }
+        cmd.updates.push_back(queued);
+    }
+    if (!cmd.updates.empty()) {
+        PlaneCommands::post(std::move(cmd));
+    }
+}
+
 void
 XPMPUpdatePlanes(
     XPMPUpdate_t *inUpdates,
@@ -341,6 +570,11 @@ XPMPUpdatePlanes(
 {
     auto *ptr = reinterpret_cast<uint8_t *>(inUpdates);
 
+    if (!PlaneCommands::onSimThread()) {
+        QueueUpdates(ptr, inUpdateSize, inCount);
+        return;
+    }
+
     for (size_t idx = 0; idx < inCount; idx++) {
         auto *thisUpdate = reinterpret_cast<XPMPUpdate_t *>(ptr + (idx *
                                                                    inUpdateSize));
@@ -356,9 +590,12 @@ XPMPUpdatePlanes(
         }
 
         auto *plane = XPMPPlaneFromID(thisUpdate->plane);
+        if (plane == nullptr) {
+            continue;
+        }
 
         if (thisUpdate->position) {
-            plane->updatePosition(*thisUpdate->position);
+            gPlanes.updatePosition(*plane, *thisUpdate->position);
         }
         if (thisUpdate->surfaces) {
             plane->updateSurfaces(*thisUpdate->surfaces);
@@ -370,3 +607,34 @@ XPMPUpdatePlanes(
         // guards against new struct members should begin below.
     }
 }
+
+void
+XPMPUpdatePlaneBatch(const XPMPPlaneBatch_t *inBatch)
+{
+    // the original batch structure ran up to the surfaces array - only the
+    // fields after it are optional.
+    if (inBatch == nullptr ||
+        inBatch->size < offsetof(XPMPPlaneBatch_t, surfaces) + sizeof(inBatch->surfaces)) {
+        return;
+    }
+    // the batch is applied in place, so it can't be deferred.
+    if (!PlaneCommands::onSimThread()) {
+        return;
+    }
+    gPlanes.updateBatch(*inBatch);
+}
+
+size_t
+XPMPGetMatchTrace(XPMPMatchTrace_t *outEntries, size_t inMaxEntries)
+{
+    if (outEntries == nullptr) {
+        return 0;
+    }
+    return MatchTrace::copyOut(outEntries, inMaxEntries);
+}
+
+void
+XPMPDumpMatchTrace(void)
+{
+    MatchTrace::dump();
+}
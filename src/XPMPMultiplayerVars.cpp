@@ -28,19 +28,36 @@
 
 #include "PlaneType.h"
 #include "XPMPMultiplayerVars.h"
+#include "PlaneRegistry.h"
 
 XPMPConfiguration_t				gConfiguration = {
 	3.0,	// maxFullAircraftRenderingDistance
 	false,	// enableSurfaceClamping
-	{ false }	// debug options
+	{ false },	// debug options
+	false,	// preferResidentModels
+	0,		// residentMatchTolerance
+	4,		// rematchSwapsPerFrame
+	1.0,	// interpolationDelay
+	2.0,	// maxExtrapolation
+	8,		// offscreenUpdateInterval
+	3.0,	// nearTierDistance
+	0.05f,	// nearTierScreenSize
+	15.0,	// farTierDistance
+	4,		// midTierUpdateInterval
+	16,		// farTierUpdateInterval
+	0,		// frameBudget
+	0.0,	// maxLightsOnlyDistance
+	0,		// maxRenderedAircraft
+	0.0		// targetFrameRate
 };
 
 PlaneType						gDefaultPlane;
 
-XPMPPlaneMap					gPlanes;
+PlaneRegistry					gPlanes;
 int								gDumpOneRenderCycle = 0;
 
 std::vector<CSLPackage_t>		gPackages;
+CSLCatalog_t					gCatalog;
 std::unordered_map<std::string, std::string>		gGroupings;
 
 std::unordered_map<std::string, CSLAircraftCode_t>	gAircraftCodes;
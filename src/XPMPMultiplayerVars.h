@@ -36,6 +36,7 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <utility>
 
 #include "XPMPMultiplayer.h"
 
@@ -84,10 +85,27 @@ struct	CSLPackage_t {
 	std::string					path;
 	std::vector<CSL *>			planes;
 	std::unordered_map<std::string, int>	matches[match_count];
+	int							catalogOffset = 0;	// index of planes[0] in gCatalog
 };
 
 extern std::vector<CSLPackage_t>		gPackages;
 
+// The model catalog - a flat view over the planes of every package, in package
+// order, so we can index models directly rather than walking gPackages.
+//
+// byICAO and byAirline are sorted (key, catalog index) pairs to permit prefix
+// searches over the catalog.
+//
+// generation is incremented every time the catalog is rebuilt.
+struct	CSLCatalog_t {
+	std::vector<CSL *>							models;
+	std::vector<std::pair<std::string, int>>	byICAO;
+	std::vector<std::pair<std::string, int>>	byAirline;
+	unsigned									generation = 0;
+};
+
+extern CSLCatalog_t						gCatalog;
+
 extern std::unordered_map<std::string, std::string>		gGroupings;
 
 /**************** Model matching using ICAO doc 8643
@@ -106,11 +124,8 @@ extern std::unordered_map<std::string, CSLAircraftCode_t>	gAircraftCodes;
 #include "XPMPPlane.h"
 
 typedef	XPMPPlane *								XPMPPlanePtr;
-typedef	std::unordered_map<void *, std::unique_ptr<XPMPPlane>>		XPMPPlaneMap;
 
 extern XPMPConfiguration_t				gConfiguration;
 extern PlaneType						gDefaultPlane;
 
-extern XPMPPlaneMap					gPlanes;				// All planes
-
 #endif
@@ -24,7 +24,6 @@
 #include <algorithm>
 #include <cstring>
 
-#include <XPLMGraphics.h>
 #include <XPLMProcessing.h>
 #include <XPLMPlanes.h>
 #include <XPLMDataAccess.h>
@@ -40,14 +39,81 @@
 
 using namespace std;
 
-XPMPPlane::XPMPPlane() :
+XPMPPlane::XPMPPlane(XPMPPlaneID id) :
+	mID(id),
 	mPlaneType("", "", ""),
+	mPosition{},
+	mSurface{},
+	mSurveillance{},
 	mCSL(nullptr),
 	mMatchQuality(0),
+	mDirty(true),
+	mLocalX(0.0),
+	mLocalY(0.0),
+	mLocalZ(0.0),
+	mRepositioned(false),
+	mApplyPending(false),
+	mDeferred(false),
+	mMoveOnly(false),
+	mReleasePending(false),
+	mUpdateOwed(false),
 	mInstanceData(nullptr)
 {
 }
 
+XPMPPlane::XPMPPlane(XPMPPlane &&moveSrc) noexcept :
+	mID(moveSrc.mID),
+	mPlaneType(std::move(moveSrc.mPlaneType)),
+	mPosition(moveSrc.mPosition),
+	mSurface(moveSrc.mSurface),
+	mSurveillance(moveSrc.mSurveillance),
+	mCSL(moveSrc.mCSL),
+	mMatchQuality(moveSrc.mMatchQuality),
+	mDirty(moveSrc.mDirty),
+	mLocalX(moveSrc.mLocalX),
+	mLocalY(moveSrc.mLocalY),
+	mLocalZ(moveSrc.mLocalZ),
+	mRepositioned(moveSrc.mRepositioned),
+	mApplyPending(moveSrc.mApplyPending),
+	mDeferred(moveSrc.mDeferred),
+	mMoveOnly(moveSrc.mMoveOnly),
+	mReleasePending(moveSrc.mReleasePending),
+	mUpdateOwed(moveSrc.mUpdateOwed),
+	mInstanceData(moveSrc.mInstanceData)
+{
+	moveSrc.mCSL = nullptr;
+	moveSrc.mInstanceData = nullptr;
+}
+
+XPMPPlane &
+XPMPPlane::operator=(XPMPPlane &&moveSrc) noexcept
+{
+	if (this != &moveSrc) {
+		setCSL(nullptr);
+		mID = moveSrc.mID;
+		mPlaneType = moveSrc.mPlaneType;
+		mPosition = moveSrc.mPosition;
+		mSurface = moveSrc.mSurface;
+		mSurveillance = moveSrc.mSurveillance;
+		mCSL = moveSrc.mCSL;
+		mMatchQuality = moveSrc.mMatchQuality;
+		mDirty = moveSrc.mDirty;
+		mLocalX = moveSrc.mLocalX;
+		mLocalY = moveSrc.mLocalY;
+		mLocalZ = moveSrc.mLocalZ;
+		mRepositioned = moveSrc.mRepositioned;
+		mApplyPending = moveSrc.mApplyPending;
+		mDeferred = moveSrc.mDeferred;
+		mMoveOnly = moveSrc.mMoveOnly;
+		mReleasePending = moveSrc.mReleasePending;
+		mUpdateOwed = moveSrc.mUpdateOwed;
+		mInstanceData = moveSrc.mInstanceData;
+		moveSrc.mCSL = nullptr;
+		moveSrc.mInstanceData = nullptr;
+	}
+	return *this;
+}
+
 XPMPPlane::~XPMPPlane()
 {
 	setCSL(nullptr);
@@ -78,12 +144,14 @@ void
 XPMPPlane::updatePosition(const XPMPPlanePosition_t &newPosition)
 {
 	memcpy(&mPosition, &newPosition, min(newPosition.size, sizeof(mPosition)));
+	mDirty = true;
 }
 
 void
 XPMPPlane::updateSurfaces(const XPMPPlaneSurfaces_t &newSurfaces)
 {
 	memcpy(&mSurface, &newSurfaces, min(newSurfaces.size, sizeof(mSurface)));
+	mDirty = true;
 }
 
 void
@@ -92,64 +160,184 @@ XPMPPlane::updateSurveillance(const XPMPPlaneSurveillance_t &newSurveillance)
 	memcpy(&mSurveillance, &newSurveillance, min(newSurveillance.size, sizeof(mSurveillance)));
 }
 
-float
-XPMPPlane::doInstanceUpdate(const CullInfo &gl_camera)
-{
-	if (mCSL) {
-		double	lx,ly,lz;
-
-		XPLMWorldToLocal(mPosition.lat, mPosition.lon, mPosition.elevation * kFtToMeters, &lx, &ly, &lz);
-		XPLMPlaneDrawState_t planeState = {};
-
-		planeState.structSize = sizeof(planeState);
-		planeState.gearPosition = mSurface.gearPosition;
-		planeState.flapRatio = mSurface.flapRatio;
-		planeState.spoilerRatio = mSurface.spoilerRatio;
-		planeState.speedBrakeRatio = mSurface.speedBrakeRatio;
-		planeState.slatRatio = mSurface.slatRatio;
-		planeState.wingSweep = mSurface.wingSweep;
-		planeState.thrust = mSurface.thrust;
-		planeState.yokePitch = mSurface.yokePitch;
-		planeState.yokeHeading = mSurface.yokeHeading;
-		planeState.yokeRoll = mSurface.yokeRoll;
-
-        mCSL->updateInstance(
-            gl_camera,
-            lx,
-            ly,
-            lz,
-            mPosition.roll,
-            mPosition.heading,
-            mPosition.pitch,
-            mPosition.clampToGround,
-            mPosition.offsetScale,
-            mSurface.lights,
-            mInstanceData,
-            &planeState);
-
+void
+XPMPPlane::beginUpdate(const double local[3], bool forceRefresh, UpdateMode mode, bool overBudget)
+{
+	mRepositioned = false;
+	mApplyPending = false;
+	mDeferred = false;
+	mMoveOnly = false;
+	mReleasePending = false;
+	if (mCSL == nullptr) {
+		return;
+	}
+	if (mUpdateOwed) {
+		mode = UpdateMode::Full;
+	}
+	// released instances stay that way until the plane is back within the
+	// visibility.
+	if (mInstanceData && mInstanceData->isReleased() && mInstanceData->mCulled) {
+		mode = UpdateMode::Defer;
+	}
+	// new instances need a full update to get going, and refreshes are only
+	// worth doing in full.
+	if (mInstanceData == nullptr || (forceRefresh && mode == UpdateMode::Move)) {
+		mode = UpdateMode::Full;
+	}
+	if (mode == UpdateMode::Defer) {
+		// the instance stays where it is (and stays dirty), but tcas still
+		// needs to know where the plane really is.
+		if (mDirty) {
+			mLocalX = local[0];
+			mLocalY = local[1];
+			mLocalZ = local[2];
+		}
+		mDeferred = true;
+		return;
+	}
+	// nothing's moved - the position from the last update still stands.
+	if (mInstanceData && !mDirty && !forceRefresh) {
+		return;
+	}
+	// if we're out of time, new planes will have to wait for their
+	// instances, and the rest can just be moved for now.
+	if (overBudget && mode == UpdateMode::Full) {
+		mUpdateOwed = true;
 		if (mInstanceData == nullptr) {
-			return 0.0;
+			return;
 		}
-		// populate the global TCAS list
-		TCAS::addPlane(mInstanceData->mDistanceSqr, static_cast<float>(lx), static_cast<float>(ly), static_cast<float>(lz),
-			mPosition.heading, mPosition.label, this);
+		mode = UpdateMode::Move;
+	}
+	double	lx = local[0];
+	double	ly = local[1];
+	double	lz = local[2];
 
-		// do labels.
-#if 0
-		if (!mInstanceData->mCulled && mInstanceData->mDistanceSqr <= (Render_LabelDistance * Render_LabelDistance)) {
-			float tx, ty;
-
-			gl_camera.ConvertTo2D(lx, ly, lz, 1.0, &tx, &ty);
-			gLabelList.emplace_back(Label{
-				tx, ty,
-				mInstanceData->mDistanceSqr,
-				string(mPosition.label) 
-			});
+	const bool full = (mode == UpdateMode::Full);
+	if (!mCSL->positionInstance(lx, ly, lz, mPosition.clampToGround, mPosition.offsetScale, full, mInstanceData)) {
+		return;
+	}
+	mLocalX = lx;
+	mLocalY = ly;
+	mLocalZ = lz;
+	mRepositioned = true;
+	mMoveOnly = !full;
+}
+
+void
+XPMPPlane::prepareUpdate(const FrameContext &frame, const PlaneKinematics_t &kinematics)
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return;
+	}
+	mInstanceData->updateDistance(frame, mLocalX, mLocalY, mLocalZ);
+	// if it's been out of sight for a while, there's no point updating it -
+	// let go of the instance until it's back.
+	if (mInstanceData->canRelease(frame)) {
+		mReleasePending = !mInstanceData->isReleased();
+		return;
+	}
+	if (!mRepositioned) {
+		// so long as the instance is still at the right level of detail for
+		// the camera, all we need is the new distance.
+		if (mDeferred || !mInstanceData->needsUpdate()) {
+			return;
 		}
+	} else if (mMoveOnly && !mInstanceData->needsUpdate()) {
+		// between full updates, the rest of the update stands as it was.
+		mCSL->moveInstance(
+			mLocalX,
+			mLocalY,
+			mLocalZ,
+			kinematics.roll,
+			kinematics.heading,
+			kinematics.pitch,
+			mInstanceData);
+		mApplyPending = true;
+		return;
+	}
+	XPLMPlaneDrawState_t planeState = {};
+
+	planeState.structSize = sizeof(planeState);
+	planeState.gearPosition = mSurface.gearPosition;
+	planeState.flapRatio = mSurface.flapRatio;
+	planeState.spoilerRatio = mSurface.spoilerRatio;
+	planeState.speedBrakeRatio = mSurface.speedBrakeRatio;
+	planeState.slatRatio = mSurface.slatRatio;
+	planeState.wingSweep = mSurface.wingSweep;
+	planeState.thrust = mSurface.thrust;
+	planeState.yokePitch = mSurface.yokePitch;
+	planeState.yokeHeading = mSurface.yokeHeading;
+	planeState.yokeRoll = mSurface.yokeRoll;
+
+	mCSL->prepareInstance(
+		frame,
+		mLocalX,
+		mLocalY,
+		mLocalZ,
+		kinematics.roll,
+		kinematics.heading,
+		kinematics.pitch,
+		mSurface.lights,
+		&planeState,
+		mInstanceData);
+	mApplyPending = true;
+}
+
+float
+XPMPPlane::finishUpdate(bool overBudget)
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return 0.0;
+	}
+	if (mApplyPending && overBudget) {
+		// out of time - the update will have to be worked out again.
+		mDirty = true;
+		mUpdateOwed = mUpdateOwed || !mMoveOnly;
+		mRepositioned = false;
+		mApplyPending = false;
+	}
+	if (mApplyPending) {
+		mCSL->applyInstance(mInstanceData);
+		mApplyPending = false;
+	}
+	if (mReleasePending) {
+		mCSL->releaseInstance(mInstanceData);
+		mReleasePending = false;
+	}
+	if (mRepositioned) {
+		// spinning engines are animated by us, so they need updating every
+		// frame, planes that couldn't be clamped need to try again, and
+		// planes that were only moved still need their full update.
+		mDirty = mMoveOnly || (mSurface.thrust > 0.0f) || mInstanceData->mClampPending;
+		mUpdateOwed = mUpdateOwed && mMoveOnly;
+		mRepositioned = false;
+	}
+
+	// do labels.
+#if 0
+	if (!mInstanceData->mCulled && mInstanceData->mDistanceSqr <= (Render_LabelDistance * Render_LabelDistance)) {
+		float tx, ty;
+
+		gl_camera.ConvertTo2D(mLocalX, mLocalY, mLocalZ, 1.0, &tx, &ty);
+		gLabelList.emplace_back(Label{
+			tx, ty,
+			mInstanceData->mDistanceSqr,
+			string(mPosition.label)
+		});
+	}
 #endif
-		return mInstanceData->mDistanceSqr;
+	return mInstanceData->mDistanceSqr;
+}
+
+bool
+XPMPPlane::addToTCAS(const PlaneKinematics_t &kinematics) const
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return false;
 	}
-	return 0.0;
+	return TCAS::addPlane(mInstanceData->mDistanceSqr,
+		static_cast<float>(mLocalX), static_cast<float>(mLocalY), static_cast<float>(mLocalZ),
+		kinematics.heading, mPosition.label, mID);
 }
 
 void
@@ -177,8 +365,34 @@ XPMPPlane::upgradeCSL(const PlaneType &type)
 	return false;
 }
 
+bool
+XPMPPlane::offerCSL(CSL *csl, int matchQuality, bool takeEqual)
+{
+	if (csl == nullptr || csl == mCSL) {
+		return false;
+	}
+	if (matchQuality < 0) {
+		// an unrated match can only stand in for another one.
+		if (!takeEqual || mMatchQuality >= 0) {
+			return false;
+		}
+	} else if (mMatchQuality >= 0 &&
+		(matchQuality > mMatchQuality || (matchQuality == mMatchQuality && !takeEqual))) {
+		return false;
+	}
+	setCSL(csl);
+	mMatchQuality = matchQuality;
+	return true;
+}
+
 int
 XPMPPlane::getMatchQuality()
 {
 	return mMatchQuality;
 }
+
+const PlaneType &
+XPMPPlane::getType() const
+{
+	return mPlaneType;
+}
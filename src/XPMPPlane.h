@@ -26,14 +26,33 @@
 #include "XPMPMultiplayerVars.h"
 #include "PlaneType.h"
 #include "CullInfo.h"
+#include "UpdateScheduler.h"
 
 class XPMPMapRendering;
 
+/** PlaneKinematics_t is the position and attitude of a single plane.
+ *
+ * The PlaneRegistry keeps these for all of the planes in
+ * structure-of-arrays form - this is just a single plane's view of that.
+ */
+struct PlaneKinematics_t {
+	double	lat;
+	double	lon;
+	double	elevation;	// feet
+	float	pitch;
+	float	roll;
+	float	heading;
+};
+
 class XPMPPlane {
 private:
+	XPMPPlaneID			mID;
+
 	// world state
 	PlaneType			mPlaneType;
 
+	// the position and attitude in mPosition are ignored - the PlaneRegistry
+	// holds them.  This is only used for the other fields.
 	XPMPPlanePosition_t	mPosition;
 	XPMPPlaneSurfaces_t	mSurface;
 	XPMPPlaneSurveillance_t	mSurveillance;
@@ -42,12 +61,43 @@ private:
 	CSL *				mCSL;
 	int					mMatchQuality;
 
+	// set whenever something that affects the rendered instance changes.  If
+	// it's clear, the local position from the last update is still good.
+	bool				mDirty;
+	double				mLocalX;
+	double				mLocalY;
+	double				mLocalZ;
+
+	// per-frame update progress - see beginUpdate et al.
+	bool				mRepositioned;
+	bool				mApplyPending;
+	bool				mDeferred;
+	bool				mMoveOnly;
+	bool				mReleasePending;
+
+	// set when a full update was put off for lack of time - it's done as
+	// soon as there's time for it.
+	bool				mUpdateOwed;
+
 	friend void Render_PrepLists();
 	friend class XPMPMapRendering;
+	friend class PlaneSnapshot;
 public:
-	XPMPPlane();
+	explicit XPMPPlane(XPMPPlaneID id);
 	virtual ~XPMPPlane();
 
+	// planes are moved around by the PlaneRegistry, but never copied - they
+	// own their instance data.
+	XPMPPlane(const XPMPPlane &copySrc) = delete;
+	XPMPPlane &operator=(const XPMPPlane &copySrc) = delete;
+	XPMPPlane(XPMPPlane &&moveSrc) noexcept;
+	XPMPPlane &operator=(XPMPPlane &&moveSrc) noexcept;
+
+	XPMPPlaneID getID() const
+	{
+		return mID;
+	}
+
 	void setType(const PlaneType &type);
 	void setCSL(CSL *csl);
 	void setCSL(const PlaneType &type);
@@ -59,19 +109,103 @@ public:
 	 * @return true if the type was changed, false otherwise.
 	 */
 	bool upgradeCSL(const PlaneType &type);
+	/** offerCSL switches to a CSL that has already been matched, but only if
+	 * it's a better match than the current one.
+	 *
+	 * @param csl the candidate CSL
+	 * @param matchQuality the quality of the candidate's match
+	 * @param takeEqual if true, a different CSL that's as good a match (or
+	 *     unrated, if the current one is too) is taken as well.
+	 * @return true if the CSL was changed, false otherwise.
+	 */
+	bool offerCSL(CSL *csl, int matchQuality, bool takeEqual);
 	int  getMatchQuality();
+	const PlaneType &getType() const;
+
+	/** isUpdateOwed reports if the plane has work put off from an earlier
+	 * frame for lack of time.
+	 */
+	bool isUpdateOwed() const
+	{
+		return mUpdateOwed;
+	}
+
+	/** markDirty forces the next doInstanceUpdate to reposition the plane
+	 * from scratch.
+	 */
+	void markDirty()
+	{
+		mDirty = true;
+	}
 
 	void updatePosition(const XPMPPlanePosition_t &newPosition);
 	void updateSurfaces(const XPMPPlaneSurfaces_t &newSurfaces);
 	void updateSurveillance(const XPMPPlaneSurveillance_t &newSurveillance);
 
-	/** Updates the specific plane's instance data and prepares it's tcas
-	 * (and culling flags for selfrendered models)
+	/* The per-frame update of the plane's instance data and tcas entry is
+	 * done in three stages, each of which is run over all the planes before
+	 * the next:
 	 *
-	 * @param gl_camera the CullInfo from the rendering loop
+	 * beginUpdate (sim thread) places the plane in the local coordinate
+	 * system.  If the plane isn't dirty, this is skipped and the position
+	 * from the last update is reused.  The UpdateScheduler decides how much
+	 * of the update to do:  if it's only to be moved, the terrain isn't
+	 * looked up again, and only the instance's position is updated.  If the
+	 * update is deferred (because the plane's out of view), the instance is
+	 * left as it is until a later frame, and only the distance and tcas
+	 * entry are kept up to date.  If the frame's over budget, full updates
+	 * (and new instances) are put off until a frame that isn't, and the
+	 * plane is just moved.
+	 * Planes that have been culled for a while are treated the same way, and
+	 * release their instances until they're back within the visibility.
+	 *
+	 * prepareUpdate (any thread) works out the distance, culling and, if
+	 * the instance needs updating, everything needed to do so.
+	 *
+	 * finishUpdate (sim thread) pushes the update to the sim if there is
+	 * one (unless the frame's over budget, in which case it's redone on a
+	 * later frame).
+	 *
+	 * addToTCAS (sim thread) reports the plane to tcas - only the nearest
+	 * planes are, so it's called for those separately.
+	 */
+
+	/** beginUpdate does the first stage of the per-frame update.
+	 *
+	 * @param local the plane's position in local coordinates (x, y, z)
+	 * @param forceRefresh if true, fully update the plane even if it's not
+	 *     dirty.
+	 * @param mode how much of the update to do this frame.
+	 * @param overBudget if true, the frame's out of time for anything that
+	 *     can wait.
+	 */
+	void beginUpdate(const double local[3], bool forceRefresh, UpdateMode mode, bool overBudget);
+
+	/** prepareUpdate does the second stage of the per-frame update.  It
+	 * doesn't call the XPLM, and only touches this plane, so may be called
+	 * for different planes concurrently.
+	 *
+	 * @param frame the values read from the sim for this frame
+	 * @param kinematics the plane's position and attitude
+	 */
+	void prepareUpdate(const FrameContext &frame, const PlaneKinematics_t &kinematics);
+
+	/** finishUpdate does the last stage of the per-frame update.
+	 *
+	 * @param overBudget if true, the frame's out of time for anything that
+	 *     can wait.
 	 * @returns the square of the distance from the camera
 	 */
-	float doInstanceUpdate(const CullInfo &gl_camera);
+	float finishUpdate(bool overBudget);
+
+	/** addToTCAS adds the plane, as it was placed by the last update, to the
+	 * list of aircraft reported to tcas this frame.
+	 *
+	 * @param kinematics the plane's position and attitude
+	 * @return true if the plane was added - planes without an instance
+	 *     aren't.
+	 */
+	bool addToTCAS(const PlaneKinematics_t &kinematics) const;
 
 	// instanceData is public for the convenience of the main render loop only.
 	CSLInstanceData *	mInstanceData;
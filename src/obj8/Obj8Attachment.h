@@ -25,6 +25,7 @@
 #ifndef OBJ8ATTACHMENT_H
 #define OBJ8ATTACHMENT_H
 
+#include <atomic>
 #include <string>
 #include <utility>
 #include <queue>
@@ -52,7 +53,7 @@ public:
 	Obj8Attachment(Obj8Attachment &&moveSrc) noexcept:
             mFile(std::move(moveSrc.mFile)),
             mHandle(moveSrc.mHandle),
-            mLoadState(moveSrc.mLoadState)
+            mLoadState(moveSrc.mLoadState.load())
     {
         moveSrc.reset();
     }
@@ -83,7 +84,8 @@ public:
 protected:
 	std::string			mFile;
 	XPLMObjectRef		mHandle;
-	Obj8LoadState		mLoadState;
+	// atomic as it's also read when matching on the worker threads.
+	std::atomic<Obj8LoadState>	mLoadState;
 
     explicit Obj8Attachment(std::string fileName):
         mFile(std::move(fileName)),
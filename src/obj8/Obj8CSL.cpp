@@ -76,6 +76,8 @@ const char * Obj8CSL::dref_names[] = {
 	"libxplanemp/engines/engine_rotation_speed_rad_sec4",
 	nullptr
 };
+static_assert(sizeof(Obj8CSL::dref_names) / sizeof(Obj8CSL::dref_names[0]) == Obj8InstanceData::cDataRefCount + 1,
+	"Obj8InstanceData::cDataRefCount must match dref_names");
 
 std::vector<float> Obj8CSL::dref_values;
 
@@ -153,6 +155,23 @@ Obj8CSL::getModelType() const
 	return cObj8ModelType;
 }
 
+bool
+Obj8CSL::isResident() const
+{
+	// we only consider the full-detail parts - they're the ones that carry the
+	// bulk of the texture memory.
+	auto solidParts = getAttachmentsFor(Obj8DrawType::Solid);
+	if (solidParts == nullptr || solidParts->empty()) {
+		return false;
+	}
+	for (const auto &att: *solidParts) {
+		if (att->getLoadState() != Obj8LoadState::Loaded) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void
 Obj8CSL::newInstanceData(CSLInstanceData *&newInstanceData) const
 {
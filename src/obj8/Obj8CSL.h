@@ -86,6 +86,8 @@ public:
 
     const std::string& getModelType() const override;
 
+    bool isResident() const override;
+
     static void Init();
     static const char * dref_names[];
 protected:
@@ -24,15 +24,64 @@
 
 #include "Obj8InstanceData.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <iterator>
 #include <XPMPMultiplayerVars.h>
 
 #include "Obj8CSL.h"
+#include "ObjectPool.h"
+#include "LODController.h"
+
+typedef ObjectPool<sizeof(Obj8InstanceData)>	Obj8InstancePool;
+
+static Obj8InstancePool &
+InstancePool()
+{
+    // deliberately never destroyed, as instance data may still be released
+    // by other static destructors at shutdown.
+    static auto *pool = new Obj8InstancePool();
+    return *pool;
+}
+
+void *
+Obj8InstanceData::operator new(size_t size)
+{
+    // anything derived from us that's grown won't fit in the pool.
+    if (size != sizeof(Obj8InstanceData)) {
+        return ::operator new(size);
+    }
+    return InstancePool().allocate();
+}
+
+void
+Obj8InstanceData::operator delete(void *ptr, size_t size)
+{
+    if (size != sizeof(Obj8InstanceData)) {
+        ::operator delete(ptr);
+        return;
+    }
+    InstancePool().deallocate(ptr);
+}
+
+bool
+Obj8InstanceData::isFarDetail() const
+{
+	const float fullRenderDistance = gLODController.fullDetailDistance();
+	return mDistanceSqr > (fullRenderDistance * fullRenderDistance);
+}
+
+bool
+Obj8InstanceData::needsUpdate() const
+{
+    return mPartsPending || (isFarDetail() != mFarDetail);
+}
 
 void
-Obj8InstanceData::updateInstance(
-    CSL *csl,
+Obj8InstanceData::prepareInstance(
+    const CSL *csl,
+    const FrameContext &frame,
     double x,
     double y,
     double z,
@@ -40,57 +89,42 @@ Obj8InstanceData::updateInstance(
     double roll,
     double heading,
     xpmp_LightStatus lights,
-    XPLMPlaneDrawState_t *state)
+    const XPLMPlaneDrawState_t *state)
 {
-    auto *myCSL = dynamic_cast<Obj8CSL *>(csl);
+    auto *myCSL = dynamic_cast<const Obj8CSL *>(csl);
     assert(myCSL != nullptr);
 
     // determine which instance type we want.
     //FIXME: use lowlod + lights as appropriate.
-    Obj8DrawType desiredObj = Obj8DrawType::Solid;
-	auto fullRenderDistance = gConfiguration.maxFullAircraftRenderingDistance * 1000.0f;
-    if (mDistanceSqr > (fullRenderDistance * fullRenderDistance)) {
-        desiredObj = Obj8DrawType::LightsOnly;
-        if (!myCSL->hasAttachmentsFor(desiredObj)) {
-            desiredObj = Obj8DrawType::LowLevelOfDetail;
-            if (!myCSL->hasAttachmentsFor(desiredObj)) {
-                desiredObj = Obj8DrawType::Solid;
+    mDrawType = Obj8DrawType::Solid;
+    mFarDetail = isFarDetail();
+    if (mFarDetail) {
+        mDrawType = Obj8DrawType::LightsOnly;
+        if (!myCSL->hasAttachmentsFor(mDrawType)) {
+            mDrawType = Obj8DrawType::LowLevelOfDetail;
+            if (!myCSL->hasAttachmentsFor(mDrawType)) {
+                mDrawType = Obj8DrawType::Solid;
             }
         }
     }
 
-    // Handle each drawtype individually... (there's only three)
-    if (desiredObj == Obj8DrawType::Solid) {
-        instancePartsForType(myCSL, Obj8DrawType::Solid);
-    } else {
-        resetPartsForType(myCSL,Obj8DrawType::Solid);
-    }
-    if (desiredObj == Obj8DrawType::LowLevelOfDetail) {
-        instancePartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
-    } else {
-        resetPartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
-    }
-    instancePartsForType(myCSL, Obj8DrawType::LightsOnly);
-
     // build the state objects.
-    XPLMDrawInfo_t objPosition = {};
-
-    objPosition.structSize = sizeof(objPosition);
-    objPosition.x = static_cast<float>(x);
-    objPosition.y = static_cast<float>(y);
-    objPosition.z = static_cast<float>(z);
-    objPosition.heading = static_cast<float>(heading);
-    objPosition.pitch = static_cast<float>(pitch);
-    objPosition.roll = static_cast<float>(roll);
+    mDrawInfo = {};
+    mDrawInfo.structSize = sizeof(mDrawInfo);
+    mDrawInfo.x = static_cast<float>(x);
+    mDrawInfo.y = static_cast<float>(y);
+    mDrawInfo.z = static_cast<float>(z);
+    mDrawInfo.heading = static_cast<float>(heading);
+    mDrawInfo.pitch = static_cast<float>(pitch);
+    mDrawInfo.roll = static_cast<float>(roll);
 
-    static const XPLMDataRef flightTime = XPLMFindDataRef("sim/time/total_flight_time_sec");
     const float engineSpeedRPM = (state->thrust) > 0.0 ? 1200.0f : 0.0f;
     const float engineSpeedDegSec = engineSpeedRPM * 360 / 60;
     const float engineSpeedRadSec = engineSpeedRPM * 2 * 3.14159f / 60;
-    const float engineRotationDeg = std::fmod(engineSpeedDegSec * XPLMGetDataf(flightTime), 360.0f);
+    const float engineRotationDeg = std::fmod(engineSpeedDegSec * frame.flightTime, 360.0f);
 
     // these must be in the same order as defined by dref_names
-    float dataRefValues[] = {
+    const float dataRefValues[cDataRefCount] = {
         state->gearPosition,
         state->flapRatio,
         state->spoilerRatio,
@@ -113,15 +147,64 @@ Obj8InstanceData::updateInstance(
         engineSpeedRPM, engineSpeedRPM, engineSpeedRPM, engineSpeedRPM, engineSpeedRPM, engineSpeedRPM,
         engineSpeedRadSec, engineSpeedRadSec, engineSpeedRadSec, engineSpeedRadSec, engineSpeedRadSec, engineSpeedRadSec
     };
+    std::copy(std::begin(dataRefValues), std::end(dataRefValues), std::begin(mDataRefValues));
+}
+
+void
+Obj8InstanceData::moveInstance(
+    const CSL *,
+    double x,
+    double y,
+    double z,
+    double pitch,
+    double roll,
+    double heading)
+{
+    mDrawInfo.x = static_cast<float>(x);
+    mDrawInfo.y = static_cast<float>(y);
+    mDrawInfo.z = static_cast<float>(z);
+    mDrawInfo.heading = static_cast<float>(heading);
+    mDrawInfo.pitch = static_cast<float>(pitch);
+    mDrawInfo.roll = static_cast<float>(roll);
+}
+
+void
+Obj8InstanceData::applyInstance(const CSL *csl)
+{
+    auto *myCSL = dynamic_cast<const Obj8CSL *>(csl);
+    assert(myCSL != nullptr);
+
+    // Handle each drawtype individually... (there's only three)
+    mPartsPending = false;
+    if (mDrawType == Obj8DrawType::Solid) {
+        instancePartsForType(myCSL, Obj8DrawType::Solid);
+    } else {
+        resetPartsForType(myCSL,Obj8DrawType::Solid);
+    }
+    if (mDrawType == Obj8DrawType::LowLevelOfDetail) {
+        instancePartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
+    } else {
+        resetPartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
+    }
+    instancePartsForType(myCSL, Obj8DrawType::LightsOnly);
+
     for (auto &instanceSet: mInstances) {
         for (auto &instance: instanceSet) {
             if (instance) {
-                XPLMInstanceSetPosition(instance, &objPosition, dataRefValues);
+                XPLMInstanceSetPosition(instance, &mDrawInfo, mDataRefValues);
             }
         }
     }
 }
 
+void
+Obj8InstanceData::releaseInstance(const CSL *)
+{
+    resetModel();
+    // so needsUpdate brings us back.
+    mPartsPending = true;
+}
+
 void
 Obj8InstanceData::resetPartsForType(const Obj8CSL *, Obj8DrawType drawType)
 {
@@ -162,6 +245,10 @@ Obj8InstanceData::instancePartsForType(const Obj8CSL *csl,
 				instances[i] = XPLMCreateInstance(attachments[i]->getObjectHandle(),
 					                              Obj8CSL::dref_names);
             }
+            if (instances[i] == nullptr) {
+                // still loading - we'll need to come back for it.
+                mPartsPending = true;
+            }
         }
     }
 }
@@ -30,31 +30,63 @@
 
 #include "Obj8Attachment.h"
 #include "CSL.h"
+#include "SmallVector.h"
 
 class Obj8CSL;
 
-/** a single renderable instance of a Obj8CSL */
+/** a single renderable instance of a Obj8CSL
+ *
+ * These are created and destroyed every time a plane changes model, so
+ * they're allocated from a pool, and the instance lists are kept inline
+ * unless a model has an unusually large number of parts.
+ */
 class Obj8InstanceData : public CSLInstanceData {
 public:
+    // enough for most models - beyond this, the lists go to the heap.
+    static const size_t cInlineInstances = 4;
+
     const void *  mInstanceSetPtrs[Obj8DrawTypeCount];
-    std::vector<XPLMInstanceRef> mInstances[Obj8DrawTypeCount];
+    SmallVector<XPLMInstanceRef, cInlineInstances> mInstances[Obj8DrawTypeCount];
 
     //std::deque<std::pair<Obj8Attachment*,XPLMInstanceRef>>     mInstances;
 
+	// one for each of Obj8CSL::dref_names
+	static const size_t cDataRefCount = 35;
+
+	// the detail level and load state as of the last update.
+	bool          mFarDetail;
+	bool          mPartsPending;
+
+	// the update worked out by prepareInstance, for applyInstance.
+	Obj8DrawType  mDrawType;
+	XPLMDrawInfo_t mDrawInfo;
+	float         mDataRefValues[cDataRefCount];
+
 	Obj8InstanceData():
 	    mInstanceSetPtrs{nullptr,},
-	    mInstances{}
+	    mInstances{},
+	    mFarDetail(false),
+	    mPartsPending(true),
+	    mDrawType(Obj8DrawType::Solid),
+	    mDrawInfo{},
+	    mDataRefValues{}
     {};
 
 	virtual ~Obj8InstanceData() {
 	    resetModel();
 	};
 
+	bool needsUpdate() const override;
+
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	friend class Obj8CSL;
 
 protected:
-	void updateInstance(
-		CSL *csl,
+	void prepareInstance(
+		const CSL *csl,
+		const FrameContext &frame,
 		double x,
 		double y,
 		double z,
@@ -62,13 +94,28 @@ protected:
 		double roll,
 		double heading,
 		xpmp_LightStatus lights,
-		XPLMPlaneDrawState_t *state) override;
+		const XPLMPlaneDrawState_t *state) override;
+
+	void moveInstance(
+		const CSL *csl,
+		double x,
+		double y,
+		double z,
+		double pitch,
+		double roll,
+		double heading) override;
+
+	void applyInstance(const CSL *csl) override;
+
+	void releaseInstance(const CSL *csl) override;
 
 	void resetPartsForType(const Obj8CSL *csl, Obj8DrawType drawType);
 	void instancePartsForType(const Obj8CSL *csl, Obj8DrawType drawType);
 
 private:
 	void resetModel();
+
+	bool isFarDetail() const;
 };
 
 #endif //OBJ8INSTANCEDATA_H